@@ -5,13 +5,19 @@ namespace scudb {
 /*
  * BufferPoolManager Constructor
  * When log_manager is nullptr, logging is disabled (for test purpose)
+ * page_table_type selects the page table, LINEAR_HASH grows one bucket at a
+ * time instead of doubling the directory
  * WARNING: Do Not Edit This Function
  */
-    BufferPoolManager::BufferPoolManager(size_t pool_size,DiskManager *disk_manager,LogManager *log_manager): pool_size_(pool_size), disk(disk_manager),log(log_manager)
+    BufferPoolManager::BufferPoolManager(size_t pool_size,DiskManager *disk_manager,LogManager *log_manager,PageTableType page_table_type): pool_size_(pool_size), disk(disk_manager),log(log_manager)
     {
         // a consecutive memory space for buffer pool
         pages = new Page[pool_size_];
-        page_list = new ExtendibleHash<page_id_t, Page *>(BUCKET_SIZE);
+        if (page_table_type == PageTableType::LINEAR_HASH) {
+            page_list = new LinearHash<page_id_t, Page *>(BUCKET_SIZE);
+        } else {
+            page_list = new ExtendibleHash<page_id_t, Page *>(BUCKET_SIZE);
+        }
         change = new LRUReplacer<Page *>;
         free = new list<Page *>;
 
@@ -90,7 +96,8 @@ namespace scudb {
         if (pst == nullptr) {
             return false;
         }else{
-            pst->is_dirty_ = is_dirty;
+            // a clean unpin must not drop changes of an earlier pin
+            pst->is_dirty_ = pst->is_dirty_ || is_dirty;
             if(pst->GetPinCount() <= 0) return false;
             if(--pst->pin_count_ == 0) change->Insert(pst);
             return true;
@@ -125,7 +132,7 @@ namespace scudb {
  */
     bool BufferPoolManager::DeletePage(page_id_t page_id) {
         lock_guard<mutex> lck(lock);
-        Page *pst ;
+        Page *pst = nullptr;
         page_list->Find(page_id,pst);
         if(pst==nullptr){
             disk->DeallocatePage(page_id);
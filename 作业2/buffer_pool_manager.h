@@ -13,14 +13,19 @@
 #include "buffer/lru_replacer.h"
 #include "disk/disk_manager.h"
 #include "hash/extendible_hash.h"
+#include "hash/linear_hash.h"
 #include "logging/log_manager.h"
 #include "page/page.h"
 using namespace std;
 namespace scudb {
+    // hash table used for the page_id -> Page* mapping
+    enum class PageTableType { EXTENDIBLE_HASH = 0, LINEAR_HASH };
+
     class BufferPoolManager {
     public:
         BufferPoolManager(size_t pool_size, DiskManager *disk_manager,
-                          LogManager *log_manager = nullptr);
+                          LogManager *log_manager = nullptr,
+                          PageTableType page_table_type = PageTableType::EXTENDIBLE_HASH);
 
         ~BufferPoolManager();
 
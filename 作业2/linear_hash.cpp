@@ -0,0 +1,149 @@
+#include <list>
+
+#include "hash/linear_hash.h"
+#include "page/page.h"
+
+namespace scudb {
+
+/*
+ * constructor
+ * size: bucket size, a bucket is split in turn once the table holds more
+ * than size entries per bucket on average
+ */
+    template <typename K, typename V>
+    LinearHash<K, V>::LinearHash(size_t size)
+            :level(0), next(0), bucketMaxSize(size), numItems(0) {
+        bucketTable.push_back(make_shared<Bucket>());
+    }
+
+/*
+ * helper function to calculate the hashing address of input key
+ */
+    template <typename K, typename V>
+    size_t LinearHash<K, V>::HashKey(const K &key) const{
+        return hash<K>{}(key);
+    }
+
+/*
+ * helper function to return current round of the table, a full round doubles
+ * the number of buckets
+ */
+    template <typename K, typename V>
+    int LinearHash<K, V>::GetLevel() const {
+        lock_guard<mutex> lck(lock);
+        return level;
+    }
+
+/*
+ * helper function to return the index of the next bucket to be split
+ */
+    template <typename K, typename V>
+    int LinearHash<K, V>::GetSplitPointer() const {
+        lock_guard<mutex> lck(lock);
+        return next;
+    }
+
+/*
+ * helper function to return current number of bucket in hash table
+ */
+    template <typename K, typename V>
+    int LinearHash<K, V>::GetNumBuckets() const {
+        lock_guard<mutex> lck(lock);
+        return bucketTable.size();
+    }
+
+/*
+ * lookup function to find value associate with input key
+ */
+    template <typename K, typename V>
+    bool LinearHash<K, V>::Find(const K &key, V &value) {
+        lock_guard<mutex> lck(lock);
+        shared_ptr<Bucket> bucket = bucketTable[getBucketIndex(key)];
+        auto it = bucket->items.find(key);
+        if (it != bucket->items.end()) {
+            value = it->second;
+            return true;
+        }
+        return false;
+    }
+
+/*
+ * delete <key,value> entry in hash table
+ * Shrink & Combination is not required, same as ExtendibleHash
+ */
+    template <typename K, typename V>
+    bool LinearHash<K, V>::Remove(const K &key) {
+        lock_guard<mutex> lck(lock);
+        shared_ptr<Bucket> bucket = bucketTable[getBucketIndex(key)];
+        if (bucket->items.erase(key) == 0) {
+            return false;
+        }
+        numItems--;
+        return true;
+    }
+
+/*
+ * buckets before the split pointer have already been split in this round, so
+ * they are addressed with one more bit of the hash
+ */
+    template <typename K, typename V>
+    int LinearHash<K, V>::getBucketIndex(const K &key) const {
+        size_t hashkey = HashKey(key);
+        int index = hashkey & ((1 << level) - 1);
+        if (index < next) {
+            index = hashkey & ((1 << (level + 1)) - 1);
+        }
+        return index;
+    }
+
+/*
+ * split the bucket under the split pointer into itself and a new bucket
+ * appended at the end, then advance the split pointer
+ */
+    template <typename K, typename V>
+    void LinearHash<K, V>::splitNext() {
+        int mask = 1 << level;
+        shared_ptr<Bucket> oldBucket = bucketTable[next];
+        auto newBucket = make_shared<Bucket>();
+        for (auto it = oldBucket->items.begin(); it != oldBucket->items.end();) {
+            if (HashKey(it->first) & mask) {
+                newBucket->items.insert(*it);
+                it = oldBucket->items.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        bucketTable.push_back(newBucket);
+
+        if (++next == mask) {
+            level++;
+            next = 0;
+        }
+    }
+
+/*
+ * insert <key,value> entry in hash table
+ * Buckets may overflow temporarily; whenever the average load exceeds the
+ * bucket size, exactly one bucket (the one under the split pointer) is split
+ */
+    template <typename K, typename V>
+    void LinearHash<K, V>::Insert(const K &key, const V &value) {
+        lock_guard<mutex> lck(lock);
+
+        shared_ptr<Bucket> targetBucket = bucketTable[getBucketIndex(key)];
+        if (targetBucket->items.find(key) == targetBucket->items.end()) {
+            numItems++;
+        }
+        targetBucket->items[key] = value;
+
+        if (numItems > bucketMaxSize * bucketTable.size()) {
+            splitNext();
+        }
+    }
+    template class LinearHash<page_id_t, Page *>;
+    template class LinearHash<Page *, std::list<Page *>::iterator>;
+// test purpose
+    template class LinearHash<int, std::string>;
+    template class LinearHash<int, std::list<int>::iterator>;
+    template class LinearHash<int, int>;
+} // namespace scudb
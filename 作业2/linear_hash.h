@@ -0,0 +1,54 @@
+/*
+ * linear_hash.h : implementation of in-memory hash table using linear hashing
+ *
+ * Functionality: Same role as ExtendibleHash (buffer pool page table), but the
+ * table grows one bucket at a time following a split pointer instead of
+ * doubling a directory, so no single insert pays for rehashing the table.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include<map>
+#include<memory>
+#include<mutex>
+
+#include "hash/hash_table.h"
+using namespace std;
+
+namespace scudb {
+
+    template <typename K, typename V>
+    class LinearHash : public HashTable<K, V> {
+        struct Bucket {
+            Bucket() {};
+            std::map<K, V> items;
+        };
+    public:
+        // constructor, size is the average bucket size that triggers a split
+        LinearHash(size_t size);
+        // helper function to generate hash addressing
+        size_t HashKey(const K &key) const;
+        // helper function to get current level & split pointer
+        int GetLevel() const;
+        int GetSplitPointer() const;
+        int GetNumBuckets() const;
+        // lookup and modifier
+        bool Find(const K &key, V &value) override;
+        bool Remove(const K &key) override;
+        void Insert(const K &key, const V &value) override;
+
+    private:
+        int getBucketIndex(const K &key) const;
+        void splitNext();
+        int level;
+        int next;
+        size_t bucketMaxSize;
+        size_t numItems;
+        // deque: appending a bucket never moves the existing ones
+        std::deque<std::shared_ptr<Bucket>> bucketTable;
+        mutable mutex lock;
+    };
+} // namespace scudb
@@ -0,0 +1,87 @@
+/**
+ * adaptive_hash.h
+ *
+ * Adaptive hash index of a B+ tree, after the one of InnoDB: an in-memory
+ * table of the positions (leaf page id, slot) of the keys GetValue searches
+ * again and again, so that a search of such a hot key reads its leaf without
+ * a descent from the root.
+ * (1) The table has a fixed number of buckets and one key per bucket. Every
+ *     search of the key of a bucket heats it up, every search of another key
+ *     hashed to the bucket cools it down, and that key takes the bucket over
+ *     once it is cold. A key is hot, and gets its position stored, once its
+ *     heat reaches the threshold.
+ * (2) Writers never touch the table. A position is stored with the version
+ *     of its leaf (see BPlusTreePage::GetVersion) and the epoch of the table,
+ *     the tree moves on to a new epoch before it frees a page. The tree only
+ *     uses a position while both are unchanged, and the leaf still holds the
+ *     key at that slot (the version wraps around).
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "common/config.h"
+
+namespace scudb {
+
+template <typename KeyType> class AdaptiveHash {
+public:
+  // where a hot key was found
+  struct Position {
+    page_id_t page_id;
+    int slot;
+    uint16_t version;
+    uint64_t epoch;
+  };
+
+  // buckets is rounded up to a power of 2
+  AdaptiveHash(size_t buckets, int threshold);
+
+  // the position stored for key in the current epoch, counts a search
+  bool Lookup(const KeyType &key, Position &position);
+  // key was found by a descent, true if it is hot enough to be stored
+  bool Notice(const KeyType &key);
+  // position of a hot key, its epoch read under the latch of the leaf
+  void Store(const KeyType &key, const Position &position);
+
+  // stored positions are no longer used, called before a page is freed
+  void NewEpoch() { epoch_++; }
+  uint64_t Epoch() const { return epoch_; }
+
+  // a search answered from a stored position
+  void CountHit() { hits_.fetch_add(1, std::memory_order_relaxed); }
+  uint64_t Searches() const { return searches_; }
+  uint64_t Hits() const { return hits_; }
+  double HitRatio() const {
+    uint64_t searches = Searches();
+    return searches == 0 ? 0 : static_cast<double>(Hits()) / searches;
+  }
+
+private:
+  struct Bucket {
+    KeyType key;
+    Position position;
+    // 0 for an empty bucket
+    uint8_t heat;
+    bool stored;
+  };
+  // buckets sharing a latch, by the low bits of their index
+  static const size_t LATCHES = 64;
+
+  uint32_t HashKey(const KeyType &key) const;
+  bool IsKeyOf(const Bucket &bucket, const KeyType &key) const;
+
+  std::vector<Bucket> buckets_;
+  size_t mask_;
+  int threshold_;
+  std::mutex latches_[LATCHES];
+  std::atomic<uint64_t> epoch_;
+  std::atomic<uint64_t> searches_;
+  std::atomic<uint64_t> hits_;
+};
+
+} // namespace scudb
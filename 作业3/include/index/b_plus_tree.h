@@ -3,50 +3,202 @@
  *
  * Implementation of simple b+ tree data structure where internal pages direct
  * the search and leaf pages contain actual data.
- * (1) We only support unique key
+ * (1) Unique key by default; a non-unique tree keeps all values of a duplicate
+ *     key in a posting list (see BPlusTreePostingPage)
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
- * (4) Implement index iterator for range scan
+ * (4) Implement index iterator for range scan, in both directions
+ * (5) Optional B-link (Lehman-Yao) mode: every node carries a right link and a
+ *     high key, readers hold one latch at a time and move right past
+ *     concurrent splits, deletes never merge nodes
+ * (6) Optional columnar page layout: keys contiguous and values in a separate
+ *     array, integer keys are searched with SIMD when available
+ * (7) Optional prefix page layout for keys ordered by memcmp: the key bytes
+ *     shared by the key range of a page are stored once, and leaf splits push
+ *     up the shortest separator, so long keys with common leading bytes get a
+ *     higher fanout
+ * (8) Optional slotted leaf layout on top of (7): leaf entries keep their key
+ *     bytes without the zero padding behind a slot directory, so short values
+ *     of a wide key fill leaves like short keys
+ * (9) Optional subtree counts in internal pages: every child pointer carries
+ *     the number of leaf entries below it, so rank, select and range count
+ *     queries take one or two descents instead of a leaf walk
+ * (10) Optional adaptive hash index: GetValue remembers the leaf and slot of
+ *     keys it searches again and again and reads them without a descent
+ * (11) Optional Bloom filter over the keys: lookups and removes of keys that
+ *     are definitely absent return without a descent
+ * (12) Optional interpolation search inside pages of integer keys, always or
+ *     for pages whose keys a sample finds evenly spread
  */
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <vector>
 
 #include "concurrency/transaction.h"
+#include "index/adaptive_hash.h"
+#include "index/bloom_filter.h"
 #include "index/index_iterator.h"
 #include "page/b_plus_tree_internal_page.h"
 #include "page/b_plus_tree_leaf_page.h"
+#include "page/b_plus_tree_posting_page.h"
 
 namespace scudb {
 
+/*
+ * Options of a B+ tree, fixed for its life since they decide the layout of
+ * its pages. Validate rejects the combinations a layout does not support.
+ */
+struct BPlusTreeOptions {
+  // (5) B-link mode, pages reserve a high key slot
+  bool blink = false;
+  // (6) keys and values in separate arrays, see
+  // BPlusTreePage::IsColumnarLayout
+  bool columnar = false;
+  // (1) otherwise duplicate keys go to posting lists
+  bool unique = true;
+  // (7) see BPlusTreePage::IsPrefixLayout
+  bool prefix = false;
+  // (8) implies prefix, see BPlusTreePage::IsSlottedLayout
+  bool slotted = false;
+  // (9) see BPlusTreePage::IsCounted
+  bool counted = false;
+  // (12) see BPlusTreePage::IsInterpolated
+  KeySearch key_search = KeySearch::BINARY;
+
+  // @throw : Exception for an unsupported combination
+  void Validate() const;
+};
+
 #define BPLUSTREE_TYPE BPlusTree<KeyType, ValueType, KeyComparator>
 // Main class providing the API for the Interactive B+ Tree.
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTree {
+  friend class ReverseIndexIterator<KeyType, ValueType, KeyComparator>;
+
 public:
   explicit BPlusTree(const std::string &name,
                      BufferPoolManager *buffer_pool_manager,
                      const KeyComparator &comparator,
-                     page_id_t root_page_id = INVALID_PAGE_ID);
+                     page_id_t root_page_id = INVALID_PAGE_ID,
+                     const BPlusTreeOptions &options = BPlusTreeOptions());
 
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
 
-  // Insert a key-value pair into this B+ tree.
+  // Insert a key-value pair into this B+ tree. A non-unique tree only
+  // rejects a pair that already exists.
   bool Insert(const KeyType &key, const ValueType &value,
               Transaction *transaction = nullptr);
 
-  // Remove a key and its value from this B+ tree.
+  // Insert a batch of key-value pairs, items is sorted by key in place. Each
+  // descent applies all pairs that fall into the same leaf. Returns the
+  // number of pairs inserted.
+  size_t InsertBatch(std::vector<MappingType> &items,
+                     Transaction *transaction = nullptr);
+
+  // Build an empty tree bottom-up from key-value pairs in key order, next
+  // stores the next pair and returns false at the end. Leaves and internal
+  // pages are filled to fill_factor (0.5 - 1) of their capacity.
+  void BulkLoad(const std::function<bool(MappingType &)> &next,
+                double fill_factor = 1.0);
+
+  // Remove a key and its value(s) from this B+ tree.
   void Remove(const KeyType &key, Transaction *transaction = nullptr);
 
-  // return the value associated with a given key
+  // Remove a single key-value pair, other values of the key are kept.
+  void Remove(const KeyType &key, const ValueType &value,
+              Transaction *transaction = nullptr);
+
+  // Remove every key of [lo, hi] and its value(s). Pages wholly inside the
+  // range are freed without moving their entries, only the two boundary
+  // paths are trimmed and rebalanced.
+  void DeleteRange(const KeyType &lo, const KeyType &hi);
+
+  // Merge or refill the pages remembered by lazyRebalance up to half full,
+  // meant to run on a background thread. Returns the number of pages fixed.
+  size_t RebalanceDeferred();
+
+  // return the value(s) associated with a given key
   bool GetValue(const KeyType &key, std::vector<ValueType> &result,
                 Transaction *transaction = nullptr);
 
+  // GetValue for a batch of keys, results[i] holds the value(s) of keys[i].
+  // The descents of up to multiGetGroup keys are interleaved level by level
+  // to overlap their cache misses. Returns the number of keys found.
+  size_t MultiGet(const std::vector<KeyType> &keys,
+                  std::vector<std::vector<ValueType>> &results);
+
+  // Let GetValue store the positions of hot keys in an adaptive hash index
+  // of buckets keys, a key is hot from its threshold-th search (see
+  // AdaptiveHash). Call before the tree is shared between threads.
+  void EnableAdaptiveHash(size_t buckets = 16384, int threshold = 3);
+  // search and hit counters, nullptr if not enabled
+  const AdaptiveHash<KeyType> *GetAdaptiveHash() const {
+    return adaptive_hash_.get();
+  }
+
+  // Check GetValue, MultiGet and Remove against a Bloom filter sized for at
+  // least keys keys at a false positive rate of fp_rate (see BloomFilter),
+  // built from the keys already in the tree. Call before the tree is shared
+  // between threads.
+  void EnableBloomFilter(size_t keys, double fp_rate = 0.01);
+  // the filter holds many removed keys (see bloomRebuildRatio), or more
+  // keys than it was sized for
+  bool IsBloomFilterStale() const;
+  // Rebuild the filter from the keys in the tree, meant to run on a
+  // background thread. Returns the number of keys.
+  size_t RebuildBloomFilter();
+  // probe counters, nullptr if not enabled
+  const BloomFilter<KeyType> *GetBloomFilter() const {
+    return bloom_filter_.get();
+  }
+
+  // Counted tree only, in O(log n) pages. Keys are counted once, whatever
+  // the size of their posting list in a non-unique tree.
+  // number of keys in [lo, hi]
+  size_t CountRange(const KeyType &lo, const KeyType &hi);
+  // number of keys below key
+  size_t Rank(const KeyType &key);
+  // the key with rank keys below it, false if there are not that many keys
+  bool SelectByRank(size_t rank, KeyType &key);
+
   // index iterator
   INDEXITERATOR_TYPE Begin();
   INDEXITERATOR_TYPE Begin(const KeyType &key);
+  // reverse index iterator, from the greatest key or the greatest key <= key
+  REVERSE_INDEXITERATOR_TYPE ReverseBegin();
+  REVERSE_INDEXITERATOR_TYPE ReverseBegin(const KeyType &key);
+
+  // Copy about batch_size key-value pairs of [lo, hi] into result, no latch is
+  // held once it returns. Returns false when the range is exhausted,
+  // otherwise resume with lo = result.back().first, lo_inclusive = false.
+  bool ScanRange(const KeyType &lo, const KeyType &hi, size_t batch_size,
+                 std::vector<MappingType> &result, bool lo_inclusive = true,
+                 bool hi_inclusive = true);
+
+  // Split keys cutting [lo, hi] into at most partitions disjoint sub-ranges,
+  // taken from separators of the upper internal levels.
+  std::vector<KeyType> PartitionRange(const KeyType &lo, const KeyType &hi,
+                                      size_t partitions);
+
+  // Scan [lo, hi] (or the whole tree) with one thread per sub-range of
+  // PartitionRange. consumer(partition, batch) runs on the worker threads,
+  // batches of a partition come in key order, return false to stop the
+  // partition early.
+  void ParallelScanRange(
+      const KeyType &lo, const KeyType &hi, size_t partitions,
+      size_t batch_size,
+      const std::function<bool(size_t, const std::vector<MappingType> &)>
+          &consumer);
+  void ParallelScan(
+      size_t partitions, size_t batch_size,
+      const std::function<bool(size_t, const std::vector<MappingType> &)>
+          &consumer);
 
   // Print this B+ tree to stdout using a simple command-line
   std::string ToString(bool verbose = false);
@@ -66,19 +218,69 @@ public:
   // expose for test purpose
   bool Check(bool force = false);
   bool openCheck = true;
+  // writers descend with read latches and write latch only the leaf, falling
+  // back to full write crabbing when the leaf may split or merge
+  bool optimisticLatch = true;
+  // a non-root page is merged or refilled once it drops below this fraction
+  // of its max size (0.5 is the half full rule), a lower value keeps pages
+  // shrinking around a split point from merging right back
+  double mergeThreshold = 0.5;
+  // Remove remembers keys whose leaf fell below half full without reaching
+  // mergeThreshold, see RebalanceDeferred
+  bool lazyRebalance = false;
+  // share of entries a split of the rightmost leaf keeps on the left when the
+  // new key is past its last key (likewise for the internal pages above it).
+  // 0.5 splits evenly; above it increasing keys fill pages instead of leaving
+  // them half full, up to 1.0 which moves a single entry. The new pages on the
+  // rightmost path may then stay below half full, Check allows for it.
+  double appendSplitFill = 0.5;
+  // lookups of a MultiGet batch that descend together, each of them keeps a
+  // page pinned
+  size_t multiGetGroup = 16;
+  // the Bloom filter is stale once keys removed since it was built pass this
+  // share of the keys added
+  double bloomRebuildRatio = 0.25;
 private:
   BPlusTreePage *FetchPage(page_id_t page_id);
 
+  size_t MultiGetGroup(const std::vector<KeyType> &keys, const size_t *order,
+                       size_t n, std::vector<std::vector<ValueType>> &results);
+
   void StartNewTree(const KeyType &key, const ValueType &value);
 
+  bool InsertEntry(const KeyType &key, const ValueType &value,
+                   Transaction *transaction);
+
   bool InsertIntoLeaf(const KeyType &key, const ValueType &value,
                       Transaction *transaction = nullptr);
 
   void InsertIntoParent(BPlusTreePage *old_node, const KeyType &key,
                         BPlusTreePage *new_node,
-                        Transaction *transaction = nullptr);
+                        Transaction *transaction = nullptr,
+                        bool append = false);
+
+  template <typename N>
+  N *Split(N *node, Transaction *transaction, bool append = false);
+  // Init a new page with the layouts of this tree
+  void InitPage(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, page_id_t page_id) {
+    leaf->Init(page_id, columnar_, prefix_, slotted_, key_search_);
+  }
+  void InitPage(B_PLUS_TREE_INTERNAL_PAGE *node, page_id_t page_id) {
+    node->Init(page_id, columnar_, prefix_, counted_, key_search_);
+  }
 
-  template <typename N> N *Split(N *node, Transaction *transaction);
+  bool AppendToRightmostLeaf(const KeyType &key, const ValueType &value);
+  int AppendSplitSize(const BPlusTreePage *node) const;
+  void ForgetPage(page_id_t page_id);
+
+  bool AdaptiveHashGetValue(const KeyType &key, std::vector<ValueType> &result);
+  void AdaptiveHashNotice(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, const KeyType &key);
+
+  void BulkLoadLeaves(const std::function<bool(MappingType &)> &next,
+                      double fill_factor,
+                      std::vector<std::pair<KeyType, page_id_t>> &level);
+  void BulkLoadInternalLevel(double fill_factor,
+                             std::vector<std::pair<KeyType, page_id_t>> &level);
 
   template <typename N>
   bool CoalesceOrRedistribute(N *node, Transaction *transaction = nullptr);
@@ -92,15 +294,101 @@ private:
           BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *&parent,
           int index, Transaction *transaction = nullptr);
 
-  template <typename N> void Redistribute(N *neighbor_node, N *node, int index);
+  template <typename N>
+  void Redistribute(
+          N *neighbor_node, N *node,
+          BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *parent,
+          int index);
 
   bool AdjustRoot(BPlusTreePage *node);
 
+  int MergeSize(const BPlusTreePage *node) const;
+
+  void UpdatePrevPageId(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf);
+
+  // children [from, to) of a write latched internal page, unlinked by
+  // DeleteRange once its descent is done. A page of an emptied path (see
+  // EmptySubtree) then also takes the key range [low, high).
+  struct RangeUnlink {
+    Page *page;
+    int from;
+    int to;
+    bool leaf;
+    bool emptied;
+    KeyType low;
+    KeyType high;
+  };
+  size_t DeleteRangeInPage(Page *page, const KeyType &lo, const KeyType &hi,
+                           bool has_lo, bool has_hi, Page *&left_leaf,
+                           std::vector<Page *> &latched,
+                           std::vector<RangeUnlink> &unlinks,
+                           const KeyType *low = nullptr,
+                           const KeyType *high = nullptr,
+                           std::vector<KeyType> *emptied = nullptr);
+  void EmptySubtree(page_id_t page_id, const KeyType &low,
+                    const KeyType &high, Page *&left_leaf,
+                    std::vector<Page *> &latched,
+                    std::vector<RangeUnlink> &unlinks);
+  void SetKeyRange(BPlusTreePage *node, const KeyType *low,
+                   const KeyType *high);
+  int RemoveRangeFromLeaf(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, const KeyType &lo,
+                          const KeyType &hi, bool has_lo, bool has_hi);
+  void FreeSubtree(page_id_t page_id, bool leaf,
+                   std::vector<Page *> &latched);
+  void UnlatchPage(Page *page, std::vector<Page *> &latched, bool is_dirty);
+  bool RebalancePath(const KeyType &key);
+  template <typename N>
+  void RefillPage(B_PLUS_TREE_INTERNAL_PAGE *parent, int index, N *node,
+                  std::vector<Page *> &latched,
+                  std::vector<page_id_t> &deleted);
+
+  void RemoveEntry(const KeyType &key, const ValueType *value,
+                   Transaction *transaction);
+
+  // subtree counts of a counted tree
+  size_t SubtreeCount(const BPlusTreePage *node) const;
+  size_t SubtreeCount(page_id_t page_id);
+  void UpdateCount(B_PLUS_TREE_INTERNAL_PAGE *parent,
+                   const BPlusTreePage *child);
+  void AddToPathCounts(Transaction *transaction, int delta);
+  size_t RankInTree(const KeyType &key, bool inclusive);
+
+  // posting lists of a write latched leaf page
+  bool InsertPosting(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, const KeyType &key,
+                     const ValueType &old_value, const ValueType &value);
+  bool RemovePosting(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, const KeyType &key,
+                     const ValueType *value);
+  void GetPostings(const ValueType &value, std::vector<ValueType> &result);
+
   void UpdateRootPageId(int insert_record = false);
 
   BPlusTreePage *CrabingProtocalFetchPage(page_id_t page_id,OpType op, page_id_t previous, Transaction *transaction);
+  B_PLUS_TREE_INTERNAL_PAGE *GetParentPage(BPlusTreePage *node, Transaction *transaction);
+
+  // B-link mode
+  Page *BLinkFindLeafPage(const KeyType &key, bool leftMost, bool exclusive,
+                          std::vector<page_id_t> *path);
+  Page *BLinkMoveRight(Page *page, const KeyType &key, bool exclusive);
+  Page *BLinkFetchPageAtLevel(const KeyType &key, int level);
+  bool BLinkInsert(const KeyType &key, const ValueType &value);
+  void BLinkSplit(Page *page, std::vector<page_id_t> &path, int level,
+                  bool append);
+  void BLinkRemove(const KeyType &key, const ValueType *value);
+  void BLinkDeleteRange(const KeyType &lo, const KeyType &hi);
+
+  Page *ScanFindLeafPage(const KeyType &key, KeyType &upper, bool &has_upper,
+                         bool exclusive = false);
+  Page *FindPrevLeafPage(const KeyType &key, bool rightMost);
+  bool CollectSeparators(Page *page, int depth, const KeyType &lo,
+                         const KeyType &hi, std::vector<KeyType> &result);
+
+  bool OptimisticFindLeafPage(const KeyType &key, OpType op,
+                              B_PLUS_TREE_LEAF_PAGE_TYPE *&leaf,
+                              Transaction *transaction);
 
   void FreePagesInTransaction(bool exclusive,  Transaction *transaction, page_id_t cur = -1);
+  void FreePage(page_id_t page_id);
+  void FreePendingPages();
 
   inline void Lock(bool exclusive,Page * page) {
     if (exclusive) {
@@ -122,6 +410,17 @@ private:
     Unlock(exclusive,page);
     buffer_pool_manager_->UnpinPage(pageId,exclusive);
   }
+  // unpin a page reached through a stored page id, which may have been
+  // freed while it was pinned (see FreePage)
+  inline void ReleasePage(page_id_t pageId, bool is_dirty) {
+    buffer_pool_manager_->UnpinPage(pageId,is_dirty);
+    FreePendingPages();
+  }
+  // bring a fetched page into cache ahead of its search
+  static inline void PrefetchPage(Page *page) {
+    for (size_t offset = 0; offset < PAGE_SIZE; offset += 64)
+      __builtin_prefetch(page->GetData() + offset, 0, 3);
+  }
   inline void LockRootPageId(bool exclusive) {
     if (exclusive) {
       mutex_.WLock();
@@ -144,14 +443,44 @@ private:
 
 
   int isBalanced(page_id_t pid);
-  bool isPageCorr(page_id_t pid,pair<KeyType,KeyType> &out);
+  bool isPageCorr(page_id_t pid,pair<KeyType,KeyType> &out,bool rightmost = true);
+  int64_t isCountCorr(page_id_t pid);
   // member variable
   std::string index_name_;
   page_id_t root_page_id_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
+  // page layout reserves a high key slot, fixed for the life of the tree
+  const bool blink_;
+  // new pages store keys and values in separate arrays, see
+  // BPlusTreePage::IsColumnarLayout
+  const bool columnar_;
+  const bool unique_;
+  // new pages factor out the key prefix of their key range, see
+  // BPlusTreePage::IsPrefixLayout, also set for slotted
+  const bool prefix_;
+  // new leaf pages store variable length keys, see
+  // BPlusTreePage::IsSlottedLayout
+  const bool slotted_;
+  // new internal pages keep subtree counts, see BPlusTreePage::IsCounted
+  const bool counted_;
+  // key search of new pages, see BPlusTreePage::IsInterpolated
+  const KeySearch key_search_;
   RWMutex mutex_;
   static thread_local int rootLockedCnt;
+  // last leaf in key order, or INVALID_PAGE_ID; see AppendToRightmostLeaf
+  std::atomic<page_id_t> rightmost_leaf_;
+  // keys queued by lazyRebalance
+  std::mutex deferred_mutex_;
+  std::vector<KeyType> deferred_keys_;
+  // freed pages still pinned by a reader, see FreePage
+  std::mutex pending_free_mutex_;
+  std::vector<page_id_t> pending_free_;
+  std::atomic<bool> has_pending_free_;
+  // see EnableAdaptiveHash
+  std::unique_ptr<AdaptiveHash<KeyType>> adaptive_hash_;
+  // see EnableBloomFilter
+  std::unique_ptr<BloomFilter<KeyType>> bloom_filter_;
 
 };
 } // namespace scudb
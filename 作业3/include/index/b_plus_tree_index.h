@@ -4,12 +4,14 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
 
 #include "index/b_plus_tree.h"
 #include "index/index.h"
+#include "page/table_page.h"
 
 namespace scudb {
 
@@ -19,26 +21,93 @@ INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeIndex : public Index {
 
 public:
+  // options.unique is taken from metadata
   BPlusTreeIndex(IndexMetadata *metadata,
                  BufferPoolManager *buffer_pool_manager,
-                 page_id_t root_page_id = INVALID_PAGE_ID);
+                 page_id_t root_page_id = INVALID_PAGE_ID,
+                 const BPlusTreeOptions &options = BPlusTreeOptions());
 
   ~BPlusTreeIndex() {}
 
   void InsertEntry(const Tuple &key, RID rid,
                    Transaction *transaction = nullptr) override;
 
-  void DeleteEntry(const Tuple &key,
+  void DeleteEntry(const Tuple &key, RID rid,
                    Transaction *transaction = nullptr) override;
 
   void ScanKey(const Tuple &key, std::vector<RID> &result,
                Transaction *transaction = nullptr) override;
 
+  // Scan keys in [lo, hi] (either bound exclusive if asked) in batches of
+  // about batch_size rids, see BPlusTree::ScanRange. No latch is held while
+  // consumer runs, it returns false to stop the scan early.
+  void ScanRange(const Tuple &lo, const Tuple &hi, size_t batch_size,
+                 const std::function<bool(const std::vector<RID> &)> &consumer,
+                 bool lo_inclusive = true, bool hi_inclusive = true);
+
+  // Number of keys in [lo, hi] (rows of a unique index) of an index
+  // constructed with options.counted, see BPlusTree::CountRange
+  size_t CountRange(const Tuple &lo, const Tuple &hi);
+
+  // Index every tuple of the table heap whose first page is first_page_id,
+  // the index must be empty. threads workers extract and sort the keys in
+  // runs of at most sort_memory bytes in total, runs that do not fit spill
+  // to buffer pool pages, then the tree is bulk loaded from a k-way merge.
+  void BuildFromTableHeap(page_id_t first_page_id, Schema *tuple_schema,
+                          size_t threads = 1,
+                          size_t sort_memory = 64 * 1024 * 1024,
+                          double fill_factor = 1.0);
+
 protected:
+  // sorted run of the external sort, either in memory or spilled to a chain
+  // of pages that are freed as they are read
+  struct SortRun {
+    page_id_t page_id = INVALID_PAGE_ID;
+    std::vector<MappingType> entries;
+    // read position in entries or in the pinned page
+    Page *page = nullptr;
+    size_t next = 0;
+  };
+  // heap of runs ordered by their current entry
+  struct RunMerger {
+    std::vector<SortRun *> runs;
+    std::vector<MappingType> heads;
+    std::vector<size_t> heap;
+  };
+
+  void ExtractKeys(const std::vector<page_id_t> &pages, size_t begin,
+                   size_t end, Schema *tuple_schema, size_t run_size,
+                   std::vector<SortRun> &runs);
+  void SpillRun(SortRun &run, page_id_t &tail,
+                const std::vector<MappingType> &entries);
+  bool ReadRun(SortRun &run, MappingType &item);
+  void FreeRun(SortRun &run);
+  void StartMerge(RunMerger &merger);
+  bool MergeNext(RunMerger &merger, MappingType &item);
+
   // comparator for key
   KeyComparator comparator_;
+  BufferPoolManager *buffer_pool_manager_;
   // container
   BPlusTree<KeyType, ValueType, KeyComparator> container_;
 };
 
+/*
+ * Create a B+ tree index with the cheapest key type for its key schema:
+ * IntegerKey (with columnar pages) for a single INTEGER or BIGINT column,
+ * otherwise the smallest GenericKey that holds the encoded key (with prefix
+ * layout pages from 16 bytes on, and slotted leaf pages for a key with a
+ * VARCHAR column)
+ */
+Index *CreateBPlusTreeIndex(IndexMetadata *metadata,
+                            BufferPoolManager *buffer_pool_manager,
+                            page_id_t root_page_id = INVALID_PAGE_ID);
+
+// Create a B+ tree index as above and fill it from an existing table heap,
+// see BPlusTreeIndex::BuildFromTableHeap
+Index *CreateBPlusTreeIndex(IndexMetadata *metadata,
+                            BufferPoolManager *buffer_pool_manager,
+                            page_id_t first_page_id, Schema *tuple_schema,
+                            size_t threads);
+
 } // namespace scudb
@@ -0,0 +1,92 @@
+/**
+ * bloom_filter.h
+ *
+ * Bloom filter over the keys of a B+ tree, a negative answer means the key is
+ * definitely not in the tree and saves the descent to its leaf.
+ * (1) The bit array is sized for a number of keys at a false positive rate,
+ *     every key sets the bits of its hash functions (double hashing).
+ * (2) Writers add a key before it enters the tree and hold an insert guard
+ *     until it is there. Removed keys keep their bits, so the filter only
+ *     gets less selective; Rebuild replaces the bits by ones holding the
+ *     keys left. It waits for the guarded inserts in flight, then every new
+ *     insert also sets the new bits while the tree is scanned.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+namespace scudb {
+
+template <typename KeyType> class BloomFilter {
+public:
+  // sized for at least keys keys at a false positive rate of fp_rate
+  BloomFilter(size_t keys, double fp_rate);
+
+  // writers hold it while the keys they add are not in the tree yet
+  std::shared_lock<std::shared_mutex> GuardInsert() {
+    return std::shared_lock<std::shared_mutex>(insert_latch_);
+  }
+  // key is about to enter the tree, call under an insert guard
+  void Add(const KeyType &key);
+  // false means key is not in the tree, counts a probe
+  bool MayContain(const KeyType &key);
+
+  // a key left the tree, its bits stay set
+  void CountRemove() { removed_.fetch_add(1, std::memory_order_relaxed); }
+  // keys left the tree without being counted (DeleteRange)
+  void MarkStale() { stale_ = true; }
+  // removed keys passed ratio of the added ones, or more keys were added
+  // than the bits were sized for
+  bool IsStale(double ratio) const;
+
+  // Replace the bits by ones sized for the keys in the tree, scan calls its
+  // argument on every key in the tree and returns their number
+  void Rebuild(const std::function<size_t(
+                   const std::function<void(const KeyType &)> &)> &scan);
+
+  // probes answered "not in the tree", each saves a descent
+  uint64_t Probes() const { return probes_; }
+  uint64_t Negatives() const { return negatives_; }
+  double NegativeRatio() const {
+    uint64_t probes = Probes();
+    return probes == 0 ? 0 : static_cast<double>(Negatives()) / probes;
+  }
+
+private:
+  struct Bits {
+    Bits(size_t keys, double fp_rate);
+    void Set(uint64_t hash);
+    bool Test(uint64_t hash) const;
+
+    size_t keys;
+    uint64_t bits;
+    int hashes;
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+  };
+
+  uint64_t HashKey(const KeyType &key) const;
+
+  size_t min_keys_;
+  double fp_rate_;
+  // read by MayContain with std::atomic_load, replaced under the exclusive
+  // insert latch
+  std::shared_ptr<Bits> bits_;
+  // bits being rebuilt, Add sets them too
+  std::shared_ptr<Bits> rebuilt_;
+  std::shared_mutex insert_latch_;
+  // one Rebuild at a time
+  std::mutex rebuild_mutex_;
+  std::atomic<uint64_t> added_;
+  std::atomic<uint64_t> removed_;
+  std::atomic<bool> stale_;
+  std::atomic<uint64_t> probes_;
+  std::atomic<uint64_t> negatives_;
+};
+
+} // namespace scudb
@@ -0,0 +1,64 @@
+/**
+ * extendible_hash_index.h
+ *
+ * Disk-resident extendible hash index for equality-only lookups. Follows the
+ * in-memory ExtendibleHash design, but the directory and the buckets live in
+ * buffer pool pages:
+ * (1) We only support unique key, see IndexMetadata::IsUnique
+ * (2) Buckets split (and the directory doubles) on overflow
+ * (3) Shrink & Combination is not supported, same as ExtendibleHash
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common/rwmutex.h"
+#include "index/index.h"
+#include "page/hash_table_bucket_page.h"
+#include "page/hash_table_directory_page.h"
+
+namespace scudb {
+
+#define EXTENDIBLE_HASH_INDEX_TYPE                                             \
+  ExtendibleHashIndex<KeyType, ValueType, KeyComparator>
+
+INDEX_TEMPLATE_ARGUMENTS
+class ExtendibleHashIndex : public Index {
+
+public:
+  ExtendibleHashIndex(IndexMetadata *metadata,
+                      BufferPoolManager *buffer_pool_manager,
+                      page_id_t directory_page_id = INVALID_PAGE_ID);
+
+  ~ExtendibleHashIndex() {}
+
+  void InsertEntry(const Tuple &key, RID rid,
+                   Transaction *transaction = nullptr) override;
+
+  void DeleteEntry(const Tuple &key, RID rid,
+                   Transaction *transaction = nullptr) override;
+
+  void ScanKey(const Tuple &key, std::vector<RID> &result,
+               Transaction *transaction = nullptr) override;
+
+  // helper function to generate hash addressing
+  uint32_t HashKey(const KeyType &key) const;
+
+private:
+  bool Insert(const KeyType &key, const ValueType &value);
+  bool SplitBucket(HashTableDirectoryPage *directory, int bucket_index);
+  void StartNewTable();
+  HashTableDirectoryPage *FetchDirectoryPage();
+  HASH_TABLE_BUCKET_PAGE_TYPE *FetchBucketPage(page_id_t bucket_page_id);
+  void InsertDirectoryPageId(page_id_t directory_page_id);
+
+  // comparator for key
+  KeyComparator comparator_;
+  BufferPoolManager *buffer_pool_manager_;
+  page_id_t directory_page_id_;
+  RWMutex mutex_;
+};
+
+} // namespace scudb
@@ -6,6 +6,15 @@
  * This key type uses an fixed length array to hold data for indexing
  * purposes, the actual size of which is specified and instantiated
  * with a template argument.
+ *
+ * Columns are stored in an order preserving (memcmp comparable) encoding, so
+ * comparing two keys never needs to decode them:
+ * (1) integers: big-endian with the sign bit flipped
+ * (2) decimals: big-endian IEEE bits, all bits flipped for negative numbers
+ *     and only the sign bit flipped otherwise
+ * (3) varchars: bytes with 0x00 escaped as 0x00 0xFF, terminated by 0x00 0x00
+ * The rest of the key is zero padded. An encoding longer than KeySize is
+ * truncated, same as the old raw tuple copy.
  */
 #pragma once
 
@@ -17,36 +26,31 @@
 namespace scudb {
 template <size_t KeySize> class GenericKey {
 public:
-  inline void SetFromKey(const Tuple &tuple) {
+  inline void SetFromKey(const Tuple &tuple, Schema *key_schema) {
     // intialize to 0
     memset(data, 0, KeySize);
-    memcpy(data, tuple.GetData(), tuple.GetLength());
+    size_t offset = 0;
+    for (int i = 0; i < key_schema->GetColumnCount() && offset < KeySize;
+         i++) {
+      offset = EncodeValue(tuple.GetValue(key_schema, i), offset);
+    }
   }
 
   // NOTE: for test purpose only
+  // encoded as a single BIGINT column
   inline void SetFromInteger(int64_t key) {
     memset(data, 0, KeySize);
-    memcpy(data, &key, sizeof(int64_t));
-  }
-
-  inline Value ToValue(Schema *schema, int column_id) const {
-    const char *data_ptr;
-    const TypeId column_type = schema->GetType(column_id);
-    const bool is_inlined = schema->IsInlined(column_id);
-    if (is_inlined) {
-      data_ptr = (data + schema->GetOffset(column_id));
-    } else {
-      int32_t offset = *reinterpret_cast<int32_t *>(
-          const_cast<char *>(data + schema->GetOffset(column_id)));
-      data_ptr = (data + offset);
-    }
-    return Value::DeserializeFrom(data_ptr, column_type);
+    EncodeInteger(static_cast<uint64_t>(key), sizeof(int64_t), 0);
   }
 
   // NOTE: for test purpose only
-  // interpret the first 8 bytes as int64_t from data vector
+  // interpret the first 8 bytes as a BIGINT column
   inline int64_t ToString() const {
-    return *reinterpret_cast<int64_t *>(const_cast<char *>(data));
+    uint64_t v = 0;
+    for (size_t i = 0; i < sizeof(int64_t) && i < KeySize; i++) {
+      v = (v << 8) | static_cast<unsigned char>(data[i]);
+    }
+    return static_cast<int64_t>(v ^ (1ULL << 63));
   }
 
   // NOTE: for test purpose only
@@ -58,29 +62,87 @@ public:
 
   // actual location of data, extends past the end.
   char data[KeySize];
+
+private:
+  // append value at offset, return offset after it
+  inline size_t EncodeValue(const Value &value, size_t offset) {
+    switch (value.GetTypeId()) {
+    case BOOLEAN:
+    case TINYINT:
+      return EncodeInteger(static_cast<uint64_t>(value.GetAs<int8_t>()), 1,
+                           offset);
+    case SMALLINT:
+      return EncodeInteger(static_cast<uint64_t>(value.GetAs<int16_t>()), 2,
+                           offset);
+    case INTEGER:
+      return EncodeInteger(static_cast<uint64_t>(value.GetAs<int32_t>()), 4,
+                           offset);
+    case BIGINT:
+      return EncodeInteger(static_cast<uint64_t>(value.GetAs<int64_t>()), 8,
+                           offset);
+    case TIMESTAMP:
+      // unsigned, no sign bit to flip
+      return EncodeBytes(value.GetAs<uint64_t>(), 8, offset);
+    case DECIMAL: {
+      double d = value.GetAs<double>();
+      uint64_t bits;
+      memcpy(&bits, &d, sizeof(bits));
+      bits = (bits >> 63) ? ~bits : bits | (1ULL << 63);
+      return EncodeBytes(bits, 8, offset);
+    }
+    case VARCHAR:
+      return EncodeVarchar(value, offset);
+    default:
+      return offset;
+    }
+  }
+
+  // two's complement integer of width bytes, sign bit flipped
+  inline size_t EncodeInteger(uint64_t v, size_t width, size_t offset) {
+    return EncodeBytes(v ^ (1ULL << (width * 8 - 1)), width, offset);
+  }
+
+  // low width bytes of v, most significant first
+  inline size_t EncodeBytes(uint64_t v, size_t width, size_t offset) {
+    for (size_t i = 0; i < width; i++, offset++) {
+      if (offset < KeySize) {
+        data[offset] = static_cast<char>(v >> ((width - 1 - i) * 8));
+      }
+    }
+    return offset;
+  }
+
+  inline size_t EncodeVarchar(const Value &value, size_t offset) {
+    if (!value.IsNull()) {
+      const char *str = value.GetData();
+      uint32_t len = value.GetLength();
+      // stored with a trailing '\0', which is not part of the string
+      if (len > 0 && str[len - 1] == '\0') {
+        len--;
+      }
+      for (uint32_t i = 0; i < len && offset < KeySize; i++) {
+        data[offset++] = str[i];
+        if (str[i] == '\0' && offset < KeySize) {
+          data[offset++] = static_cast<char>(0xFF);
+        }
+      }
+    }
+    // terminator, data is already zeroed
+    return offset + 2;
+  }
 };
 
 /**
  * Function object returns true if lhs < rhs, used for trees
+ * Keys are memcmp comparable (see GenericKey), key schema is only kept for
+ * callers that construct comparators from it
  */
 template <size_t KeySize> class GenericComparator {
 public:
   inline int operator()(const GenericKey<KeySize> &lhs,
                         const GenericKey<KeySize> &rhs) const {
-    int column_count = key_schema_->GetColumnCount();
-
-    for (int i = 0; i < column_count; i++) {
-      Value lhs_value = (lhs.ToValue(key_schema_, i));
-      Value rhs_value = (rhs.ToValue(key_schema_, i));
-
-      if (lhs_value.CompareLessThan(rhs_value) == CMP_TRUE)
-        return -1;
-
-      if (lhs_value.CompareGreaterThan(rhs_value) == CMP_TRUE)
-        return 1;
-    }
-    // equals
-    return 0;
+    int r = memcmp(lhs.data, rhs.data, KeySize);
+    return r < 0 ? -1 : (r > 0 ? 1 : 0);
   }
 
   GenericComparator(const GenericComparator &other) {
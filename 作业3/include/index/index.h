@@ -28,8 +28,10 @@ class IndexMetadata {
 
 public:
   IndexMetadata(std::string index_name, std::string table_name,
-                const Schema *tuple_schema, const std::vector<int> &key_attrs)
-      : name_(index_name), table_name_(table_name), key_attrs_(key_attrs) {
+                const Schema *tuple_schema, const std::vector<int> &key_attrs,
+                bool is_unique = true)
+      : name_(index_name), table_name_(table_name), key_attrs_(key_attrs),
+        is_unique_(is_unique) {
     key_schema_ = Schema::CopySchema(tuple_schema, key_attrs_);
   }
 
@@ -51,6 +53,9 @@ public:
   //  columns
   inline const std::vector<int> &GetKeyAttrs() const { return key_attrs_; }
 
+  // false for a secondary index whose key may map to many tuples
+  inline bool IsUnique() const { return is_unique_; }
+
   // Get a string representation for debugging
   const std::string ToString() const {
     std::stringstream os;
@@ -71,6 +76,7 @@ private:
   const std::vector<int> key_attrs_;
   // schema of the indexed key
   Schema *key_schema_;
+  bool is_unique_;
 };
 
 /////////////////////////////////////////////////////////////////////
@@ -126,8 +132,9 @@ public:
   virtual void InsertEntry(const Tuple &key, RID rid,
                            Transaction *transaction = nullptr) = 0;
 
-  // delete the index entry linked to given tuple
-  virtual void DeleteEntry(const Tuple &key,
+  // delete the index entry linked to given tuple, rid tells the entries of a
+  // non-unique key apart
+  virtual void DeleteEntry(const Tuple &key, RID rid,
                            Transaction *transaction = nullptr) = 0;
 
   virtual void ScanKey(const Tuple &key, std::vector<RID> &result,
@@ -1,14 +1,20 @@
 /**
  * index_iterator.h
- * For range scan of b+ tree
+ * For range scan of b+ tree, in key order or (ReverseIndexIterator) in
+ * reverse key order
  */
 #pragma once
 #include "page/b_plus_tree_leaf_page.h"
+#include "page/b_plus_tree_posting_page.h"
 
 namespace scudb {
 
 #define INDEXITERATOR_TYPE                                                     \
   IndexIterator<KeyType, ValueType, KeyComparator>
+#define REVERSE_INDEXITERATOR_TYPE                                             \
+  ReverseIndexIterator<KeyType, ValueType, KeyComparator>
+
+INDEX_TEMPLATE_ARGUMENTS class BPlusTree;
 
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
@@ -21,13 +27,35 @@ public:
     return (leaf_ == nullptr);
   }
 
-  const MappingType &operator*() {
+  // by value, a columnar leaf page does not store the pair
+  MappingType operator*() {
+    if (!postings_.empty()) {
+      return MappingType(leaf_->KeyAt(index_), postings_[posting_]);
+    }
     return leaf_->GetItem(index_);
   }
 
+  // all values of a posting list reference, or value itself
+  static void ReadPostings(const ValueType &value,
+                           BufferPoolManager *bufferPoolManager,
+                           std::vector<ValueType> &result);
+
   IndexIterator &operator++() {
+    if (!postings_.empty() && ++posting_ < postings_.size()) {
+      return *this;
+    }
+    postings_.clear();
     index_++;
-    if (index_ >= leaf_->GetSize()) {
+    MoveToNextLeaf();
+    LoadPostings();
+    return *this;
+  }
+
+private:
+  // add your own private member variables here
+  // skip past the end of leaf, and past empty leaves (B-link mode)
+  void MoveToNextLeaf() {
+    while (leaf_ != nullptr && index_ >= leaf_->GetSize()) {
       page_id_t next = leaf_->GetNextPageId();
       UnlockAndUnPin();
       if (next == INVALID_PAGE_ID) {
@@ -39,19 +67,72 @@ public:
         index_ = 0;
       }
     }
-    return *this;
   }
+  void LoadPostings();
+  void UnlockAndUnPin() {
+    bufferPoolManager_->FetchPage(leaf_->GetPageId())->RUnlatch();
+    bufferPoolManager_->UnpinPage(leaf_->GetPageId(), false);
+    bufferPoolManager_->UnpinPage(leaf_->GetPageId(), false);
+  }
+  int index_;
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_;
+  BufferPoolManager *bufferPoolManager_;
+  // values of a duplicate key at index_, one key & value pair each
+  std::vector<ValueType> postings_;
+  size_t posting_;
+};
+
+/*
+ * Walks the leaves right to left through their prev page ids, one read latch
+ * at a time. A writer may latch a leaf and then its right sibling, so waiting
+ * for the left sibling while holding a leaf could deadlock; instead the left
+ * sibling is only pinned under the latch of the current leaf, then latched
+ * after the current leaf is released. If the left sibling has been split or
+ * merged meanwhile (its next page id no longer points back), the leaf before
+ * the last returned key is found again from the root. Entries are always
+ * returned in decreasing key order, skipping keys that moved right past the
+ * scan, and like IndexIterator an entry moved across leaves concurrently may
+ * be missed.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+class ReverseIndexIterator {
+public:
+  // index may be -1, then the scan starts below *bound in earlier leaves
+  ReverseIndexIterator(BPlusTree<KeyType, ValueType, KeyComparator> *tree,
+                       B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, int index,
+                       BufferPoolManager *bufferPoolManager,
+                       const KeyType *bound = nullptr);
+  ~ReverseIndexIterator();
+
+  bool isEnd() { return (leaf_ == nullptr); }
+
+  MappingType operator*() {
+    if (!postings_.empty()) {
+      return MappingType(leaf_->KeyAt(index_), postings_[posting_]);
+    }
+    return leaf_->GetItem(index_);
+  }
+
+  ReverseIndexIterator &operator++();
 
 private:
-  // add your own private member variables here
+  void MoveToPrevLeaf();
+  void LoadPostings();
   void UnlockAndUnPin() {
     bufferPoolManager_->FetchPage(leaf_->GetPageId())->RUnlatch();
     bufferPoolManager_->UnpinPage(leaf_->GetPageId(), false);
-    bufferPoolManager_->UnpinPage(leaf_->GetPageId(), false);
+    tree_->ReleasePage(leaf_->GetPageId(), false);
   }
+  BPlusTree<KeyType, ValueType, KeyComparator> *tree_;
   int index_;
   B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_;
   BufferPoolManager *bufferPoolManager_;
+  // keys >= bound_ are done, nothing is done yet if !bounded_
+  KeyType bound_;
+  bool bounded_;
+  // values of a duplicate key at index_, returned from the back
+  std::vector<ValueType> postings_;
+  size_t posting_;
 };
 
 } // namespace scudb
@@ -0,0 +1,59 @@
+/**
+ * integer_key.h
+ *
+ * Key used for indexing a single integer column
+ *
+ * Unlike GenericKey, the key is stored as a native integer of the column's
+ * width and compared directly, so it is both smaller and cheaper to compare.
+ * Only INTEGER (int32_t) and BIGINT (int64_t) columns are supported, see
+ * CreateBPlusTreeIndex.
+ */
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#include "table/tuple.h"
+#include "type/value.h"
+
+namespace scudb {
+template <typename T> class IntegerKey {
+public:
+  inline void SetFromKey(const Tuple &tuple, Schema *key_schema) {
+    key = tuple.GetValue(key_schema, 0).GetAs<T>();
+  }
+
+  // NOTE: for test purpose only
+  inline void SetFromInteger(int64_t k) { key = static_cast<T>(k); }
+
+  // NOTE: for test purpose only
+  inline int64_t ToString() const { return key; }
+
+  // NOTE: for test purpose only
+  friend std::ostream &operator<<(std::ostream &os, const IntegerKey &k) {
+    os << k.ToString();
+    return os;
+  }
+
+  T key;
+};
+
+/**
+ * Function object returns true if lhs < rhs, used for trees
+ */
+template <typename T> class IntegerComparator {
+public:
+  inline int operator()(const IntegerKey<T> &lhs,
+                        const IntegerKey<T> &rhs) const {
+    if (lhs.key < rhs.key)
+      return -1;
+    if (rhs.key < lhs.key)
+      return 1;
+    return 0;
+  }
+
+  // same constructor as GenericComparator, key schema is implied by T
+  IntegerComparator(Schema *) {}
+};
+
+} // namespace scudb
@@ -12,12 +12,31 @@
  *  --------------------------------------------------------------------------
  * | HEADER | KEY(1)+PAGE_ID(1) | KEY(2)+PAGE_ID(2) | ... | KEY(n)+PAGE_ID(n) |
  *  --------------------------------------------------------------------------
+ *
+ * Columnar layout (see BPlusTreePage::IsColumnarLayout), keys and page ids
+ * each fill a fixed share of the page so that keys are searched contiguously:
+ *  --------------------------------------------------------------------------
+ * | HEADER | KEY(1) | ... | KEY(capacity) | PAGE_ID(1) | ... | PAGE_ID(capacity)
+ *  --------------------------------------------------------------------------
+ *
+ * Prefix layout (see BPlusTreePage::IsPrefixLayout), key bytes shared by the
+ * whole key range of the page are stored once, as in BPlusTreeLeafPage:
+ *  --------------------------------------------------------------------------
+ * | HEADER | PrefixSize (2) | PREFIX | SUFFIX(1)+PAGE_ID(1) | ... |
+ *  --------------------------------------------------------------------------
+ *
+ * A counted page (see BPlusTreePage::IsCounted) of any layout also stores
+ * the number of leaf entries below every child, backwards from the page end:
+ *  --------------------------------------------------------------------------
+ * | HEADER | ENTRIES ... | free | COUNT(n) | ... | COUNT(1) | COUNT(0) |
+ *  --------------------------------------------------------------------------
  */
 
 #pragma once
 
 #include <queue>
 
+#include "page/b_plus_tree_key_search.h"
 #include "page/b_plus_tree_page.h"
 
 namespace scudb {
@@ -31,30 +50,50 @@ INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeInternalPage : public BPlusTreePage {
 public:
   // must call initialize method after "create" a new node
-  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID);
+  void Init(page_id_t page_id, bool columnar = false, bool prefix = false,
+            bool counted = false, KeySearch search = KeySearch::BINARY);
 
   KeyType KeyAt(int index) const;
   void SetKeyAt(int index, const KeyType &key);
   int ValueIndex(const ValueType &value) const;
   ValueType ValueAt(int index) const;
+  // counted page, number of leaf entries in the subtree of ValueAt(index)
+  uint32_t CountAt(int index) const;
+  void SetCountAt(int index, uint32_t count);
 
   ValueType Lookup(const KeyType &key, const KeyComparator &comparator) const;
+  // see BPlusTreeLeafPage::SampleKeySearch
+  void SampleKeySearch();
   void PopulateNewRoot(const ValueType &old_value, const KeyType &new_key,
                        const ValueType &new_value);
   int InsertNodeAfter(const ValueType &old_value, const KeyType &new_key,
                       const ValueType &new_value);
   void Remove(int index);
+  void RemoveRange(int from, int to);
   ValueType RemoveAndReturnOnlyChild();
+  // prefix layout, see BPlusTreeLeafPage
+  void SetKeyRange(const KeyType *low, const KeyType *high);
+  int GetPrefixSize() const;
+  int MaxSizeWith(const BPlusTreeInternalPage *sibling) const;
 
+  // keep: entries left in this page, half of them if -1
   void MoveHalfTo(BPlusTreeInternalPage *recipient,
-                  BufferPoolManager *buffer_pool_manager);
-  void MoveAllTo(BPlusTreeInternalPage *recipient, int index_in_parent,
+                  BufferPoolManager *buffer_pool_manager, int keep = -1);
+  // middle_key is the separator of this page and recipient in parent page
+  void MoveAllTo(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                  BufferPoolManager *buffer_pool_manager);
   void MoveFirstToEndOf(BPlusTreeInternalPage *recipient,
+                        const KeyType &middle_key,
                         BufferPoolManager *buffer_pool_manager);
   void MoveLastToFrontOf(BPlusTreeInternalPage *recipient,
-                         int parent_index,
+                         const KeyType &middle_key,
                          BufferPoolManager *buffer_pool_manager);
+  // B-link support, the last array slot holds high key + right sibling
+  void ReserveHighKey();
+  KeyType GetHighKey() const;
+  void SetHighKey(const KeyType &key);
+  page_id_t GetRightPageId() const;
+  void SetRightPageId(page_id_t right_page_id);
   // DEUBG and PRINT
   std::string ToString(bool verbose) const;
   void QueueUpChildren(std::queue<BPlusTreePage *> *queue,
@@ -67,8 +106,74 @@ private:
                    BufferPoolManager *buffer_pool_manager);
   void CopyLastFrom(const MappingType &pair,
                     BufferPoolManager *buffer_pool_manager);
-  void CopyFirstFrom(const MappingType &pair, int parent_index,
+  void CopyFirstFrom(const MappingType &pair,
                      BufferPoolManager *buffer_pool_manager);
+  // entry access for all layouts
+  int Capacity() const {
+    if (IsPrefixLayout())
+      return PrefixCapacity(PrefixSize());
+    return IsColumnarLayout()
+               ? (PAGE_SIZE - sizeof(BPlusTreeInternalPage)) /
+                     (sizeof(KeyType) + sizeof(ValueType) + CountSize())
+               : (PAGE_SIZE - sizeof(BPlusTreeInternalPage)) /
+                     (sizeof(MappingType) + CountSize());
+  }
+  int PrefixCapacity(int prefix_size) const {
+    return (PAGE_SIZE - sizeof(BPlusTreeInternalPage) - sizeof(uint16_t) -
+            prefix_size) /
+           (sizeof(KeyType) - prefix_size + sizeof(ValueType) + CountSize());
+  }
+  int CountSize() const { return IsCounted() ? sizeof(uint32_t) : 0; }
+  uint32_t *CountSlot(int index) {
+    return reinterpret_cast<uint32_t *>(reinterpret_cast<char *>(this) +
+                                        PAGE_SIZE) - 1 - index;
+  }
+  const uint32_t *CountSlot(int index) const {
+    return const_cast<BPlusTreeInternalPage *>(this)->CountSlot(index);
+  }
+  int PrefixSize() const {
+    return *reinterpret_cast<const uint16_t *>(array);
+  }
+  char *Prefix() { return reinterpret_cast<char *>(array) + sizeof(uint16_t); }
+  const char *Prefix() const {
+    return reinterpret_cast<const char *>(array) + sizeof(uint16_t);
+  }
+  int EntrySize() const {
+    return sizeof(KeyType) - PrefixSize() + sizeof(ValueType);
+  }
+  char *Entry(int index) { return Prefix() + PrefixSize() + index * EntrySize(); }
+  const char *Entry(int index) const {
+    return Prefix() + PrefixSize() + index * EntrySize();
+  }
+  KeyType *Keys() { return reinterpret_cast<KeyType *>(array); }
+  const KeyType *Keys() const {
+    return reinterpret_cast<const KeyType *>(array);
+  }
+  ValueType *Values() {
+    return reinterpret_cast<ValueType *>(Keys() + Capacity());
+  }
+  KeyType &KeySlot(int index) {
+    return IsColumnarLayout() ? Keys()[index] : array[index].first;
+  }
+  const KeyType &KeySlot(int index) const {
+    return IsColumnarLayout() ? Keys()[index] : array[index].first;
+  }
+  ValueType &ValueSlot(int index) {
+    return IsColumnarLayout() ? Values()[index] : array[index].second;
+  }
+  const ValueType &ValueSlot(int index) const {
+    return const_cast<BPlusTreeInternalPage *>(this)->ValueSlot(index);
+  }
+  // copies of a key or value, any layout
+  KeyType LoadKey(int index) const;
+  void StoreKey(int index, const KeyType &key);
+  ValueType LoadValue(int index) const;
+  void StoreValue(int index, const ValueType &value);
+  void MoveSlots(BPlusTreeInternalPage *recipient, int to, int from, int n);
+  void SetPrefix(const char *prefix, int prefix_size);
+  // prefix bytes shared with other, 0 unless both are prefix layout
+  int SharedPrefixSize(const BPlusTreeInternalPage *other) const;
+  void SharePrefixWith(const BPlusTreeInternalPage *other);
   MappingType array[0];
 };
 } // namespace scudb
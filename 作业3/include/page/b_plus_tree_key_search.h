@@ -0,0 +1,419 @@
+/**
+ * b_plus_tree_key_search.h
+ *
+ * Key search over the contiguous key array of a columnar B+ tree page (see
+ * BPlusTreePage::IsColumnarLayout).
+ *
+ * The generic version is a binary search with the comparator. IntegerKey
+ * arrays are searched as plain integers: when the build enables AVX2, a k-ary
+ * search compares the target against several pivots with one vector compare
+ * per step until the range is short, then the rest is scanned linearly with
+ * compare + movemask. Without AVX2 both steps fall back to a binary search.
+ *
+ * Interpolation search over row and columnar pages of keys with an integer
+ * ordinal (IntegerKey, GenericKey), for trees asking for it (see KeySearch).
+ *
+ * Also the byte level key helpers of the prefix and slotted layouts (see
+ * BPlusTreePage::IsPrefixLayout), which only hold keys ordered by memcmp.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "index/generic_key.h"
+#include "index/integer_key.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace scudb {
+
+/*
+ * Return the first index i in [0, n) so that keys[i] >= key, n if none
+ */
+template <typename KeyType, typename KeyComparator>
+inline int KeyLowerBound(const KeyType *keys, int n, const KeyType &key,
+                         const KeyComparator &comparator) {
+  int l = 0, r = n;
+  while (l < r) {
+    int mid = (l + r) / 2;
+    if (comparator(keys[mid], key) < 0)
+      l = mid + 1;
+    else
+      r = mid;
+  }
+  return l;
+}
+
+/*
+ * Return the first index i in [0, n) so that keys[i] > key, n if none
+ */
+template <typename KeyType, typename KeyComparator>
+inline int KeyUpperBound(const KeyType *keys, int n, const KeyType &key,
+                         const KeyComparator &comparator) {
+  int l = 0, r = n;
+  while (l < r) {
+    int mid = (l + r) / 2;
+    if (comparator(keys[mid], key) <= 0)
+      l = mid + 1;
+    else
+      r = mid;
+  }
+  return l;
+}
+
+/*
+ * Count of a[i] < x in sorted a[lo, hi), plus lo. All a[i] before lo are
+ * < x and all a[i] from hi on are >= x.
+ */
+#ifdef __AVX2__
+inline int IntegerLowerBound(const int64_t *a, int lo, int hi, int64_t x) {
+  // k-ary steps: 4 pivots split [lo, hi) into 5 parts
+  while (hi - lo > 32) {
+    int step = (hi - lo) / 5;
+    int p0 = lo + step, p1 = p0 + step, p2 = p1 + step, p3 = p2 + step;
+    __m256i pivots = _mm256_set_epi64x(a[p3], a[p2], a[p1], a[p0]);
+    __m256i lt = _mm256_cmpgt_epi64(_mm256_set1_epi64x(x), pivots);
+    int c = __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(lt)));
+    int p[4] = {p0, p1, p2, p3};
+    if (c > 0)
+      lo = p[c - 1] + 1;
+    if (c < 4)
+      hi = p[c];
+  }
+  // linear scan, stop at the first vector that is not all < x
+  __m256i vx = _mm256_set1_epi64x(x);
+  for (; lo + 4 <= hi; lo += 4) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + lo));
+    int mask = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpgt_epi64(vx, v)));
+    if (mask != 0xF)
+      return lo + __builtin_popcount(mask);
+  }
+  while (lo < hi && a[lo] < x)
+    lo++;
+  return lo;
+}
+
+inline int IntegerLowerBound(const int32_t *a, int lo, int hi, int32_t x) {
+  // k-ary steps: 8 pivots split [lo, hi) into 9 parts
+  while (hi - lo > 64) {
+    int step = (hi - lo) / 9;
+    int p[8];
+    for (int i = 0; i < 8; i++)
+      p[i] = lo + step * (i + 1);
+    __m256i pivots = _mm256_set_epi32(a[p[7]], a[p[6]], a[p[5]], a[p[4]],
+                                      a[p[3]], a[p[2]], a[p[1]], a[p[0]]);
+    __m256i lt = _mm256_cmpgt_epi32(_mm256_set1_epi32(x), pivots);
+    int c = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(lt)));
+    if (c > 0)
+      lo = p[c - 1] + 1;
+    if (c < 8)
+      hi = p[c];
+  }
+  __m256i vx = _mm256_set1_epi32(x);
+  for (; lo + 8 <= hi; lo += 8) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + lo));
+    int mask = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpgt_epi32(vx, v)));
+    if (mask != 0xFF)
+      return lo + __builtin_popcount(mask);
+  }
+  while (lo < hi && a[lo] < x)
+    lo++;
+  return lo;
+}
+#else
+template <typename T>
+inline int IntegerLowerBound(const T *a, int lo, int hi, T x) {
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (a[mid] < x)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+#endif
+
+// IntegerKey only holds the integer, so an array of keys is an integer array
+template <typename T>
+inline int KeyLowerBound(const IntegerKey<T> *keys, int n,
+                         const IntegerKey<T> &key,
+                         const IntegerComparator<T> &) {
+  return IntegerLowerBound(reinterpret_cast<const T *>(keys), 0, n, key.key);
+}
+
+// keys <= x are the keys < x + 1
+template <typename T>
+inline int KeyUpperBound(const IntegerKey<T> *keys, int n,
+                         const IntegerKey<T> &key,
+                         const IntegerComparator<T> &) {
+  if (key.key == std::numeric_limits<T>::max())
+    return n;
+  return IntegerLowerBound(reinterpret_cast<const T *>(keys), 0, n,
+                           static_cast<T>(key.key + 1));
+}
+
+/*
+ * Unsigned integer in key order, for the key types interpolation search
+ * supports
+ */
+template <typename KeyType> struct HasKeyOrdinal : std::false_type {};
+template <typename T> struct HasKeyOrdinal<IntegerKey<T>> : std::true_type {};
+template <size_t KeySize>
+struct HasKeyOrdinal<GenericKey<KeySize>> : std::true_type {};
+
+template <typename KeyType> inline uint64_t KeyOrdinal(const KeyType &) {
+  return 0;
+}
+
+// the sign bit flipped turns signed order into unsigned order
+template <typename T> inline uint64_t KeyOrdinal(const IntegerKey<T> &key) {
+  return static_cast<uint64_t>(static_cast<int64_t>(key.key)) ^ (1ULL << 63);
+}
+
+// the first 8 bytes as a big endian number, keys sharing them get the same
+// ordinal
+template <size_t KeySize>
+inline uint64_t KeyOrdinal(const GenericKey<KeySize> &key) {
+  uint64_t v = 0;
+  for (size_t i = 0; i < sizeof(uint64_t); i++)
+    v = (v << 8) | (i < KeySize ? static_cast<unsigned char>(key.data[i]) : 0);
+  return v;
+}
+
+/*
+ * Index in [0, n) of key if the n > 0 keys key_at(i) were spread evenly
+ * between the first and the last one
+ */
+template <typename KeyType, typename KeyAt>
+inline int InterpolationGuess(int n, const KeyType &key, const KeyAt &key_at) {
+  uint64_t lo = KeyOrdinal(key_at(0));
+  uint64_t hi = KeyOrdinal(key_at(n - 1));
+  uint64_t x = KeyOrdinal(key);
+  if (x <= lo || hi <= lo)
+    return 0;
+  if (x >= hi)
+    return n - 1;
+  return static_cast<int>(static_cast<double>(x - lo) / (hi - lo) * (n - 1));
+}
+
+/*
+ * Return the first index i in [0, n) so that key_at(i) >= key (> key if
+ * upper), n if none. Starts at the interpolation guess and gallops away from
+ * it in steps of 1, 2, 4... until the answer is bracketed, then binary
+ * searches the bracket: a guess e slots off costs about 2 log(e) compares,
+ * so keys that are not evenly spread cost at most twice a binary search.
+ */
+template <typename KeyType, typename KeyAt, typename KeyComparator>
+inline int InterpolationKeyBound(int n, const KeyType &key,
+                                 const KeyAt &key_at,
+                                 const KeyComparator &comparator, bool upper) {
+  if (n == 0)
+    return 0;
+  auto below = [&](int i) {
+    int c = comparator(key_at(i), key);
+    return c < 0 || (upper && c == 0);
+  };
+  int guess = InterpolationGuess(n, key, key_at);
+  // the answer is in [l, r]
+  int l, r, step = 1;
+  if (below(guess)) {
+    l = guess + 1;
+    while (l + step - 1 < n && below(l + step - 1)) {
+      l += step;
+      step *= 2;
+    }
+    r = std::min(n, l + step - 1);
+  } else {
+    r = guess;
+    while (r - step >= 0 && !below(r - step)) {
+      r -= step;
+      step *= 2;
+    }
+    l = std::max(0, r - step + 1);
+  }
+  while (l < r) {
+    int mid = (l + r) / 2;
+    if (below(mid))
+      l = mid + 1;
+    else
+      r = mid;
+  }
+  return l;
+}
+
+/*
+ * Whether the n keys key_at(i) are spread evenly enough to interpolate: the
+ * guesses for a sample of 7 of them land within a few slots of the truth
+ */
+template <typename KeyType, typename KeyAt>
+inline bool IsEvenlySpread(int n, const KeyAt &key_at) {
+  if (!HasKeyOrdinal<KeyType>::value || n < 16)
+    return false;
+  for (int j = 1; j < 8; j++) {
+    int i = n * j / 8;
+    if (std::abs(InterpolationGuess(n, key_at(i), key_at) - i) > 4)
+      return false;
+  }
+  return true;
+}
+
+/*
+ * Whether the comparator of KeyType orders keys as memcmp of their bytes, so
+ * that keys sharing a range share a byte prefix
+ */
+template <typename KeyType> struct IsMemcmpOrdered : std::false_type {};
+template <size_t KeySize>
+struct IsMemcmpOrdered<GenericKey<KeySize>> : std::true_type {};
+
+/*
+ * Number of leading bytes a and b have in common
+ */
+template <typename KeyType>
+inline int CommonPrefixSize(const KeyType &a, const KeyType &b) {
+  const char *x = reinterpret_cast<const char *>(&a);
+  const char *y = reinterpret_cast<const char *>(&b);
+  int n = 0;
+  while (n < static_cast<int>(sizeof(KeyType)) && x[n] == y[n])
+    n++;
+  return n;
+}
+
+/*
+ * Number of leading bytes shared by every key from low up to (not including)
+ * high. A null bound stands for the lowest (highest) key starting with
+ * prefix. first is set to the lowest key of the range, it starts with the
+ * shared bytes.
+ */
+template <typename KeyType>
+inline int KeyRangePrefixSize(const char *prefix, int prefix_size,
+                              const KeyType *low, const KeyType *high,
+                              KeyType &first) {
+  KeyType last;
+  char *lo = reinterpret_cast<char *>(&first);
+  unsigned char *hi = reinterpret_cast<unsigned char *>(&last);
+  if (low != nullptr) {
+    first = *low;
+  } else {
+    memcpy(lo, prefix, prefix_size);
+    memset(lo + prefix_size, 0, sizeof(KeyType) - prefix_size);
+  }
+  if (high != nullptr) {
+    // the greatest key below high: high - 1 as a big endian number
+    last = *high;
+    int i = sizeof(KeyType) - 1;
+    while (i > 0 && hi[i] == 0)
+      hi[i--] = 0xFF;
+    hi[i]--;
+  } else {
+    memcpy(hi, prefix, prefix_size);
+    memset(hi + prefix_size, 0xFF, sizeof(KeyType) - prefix_size);
+  }
+  return CommonPrefixSize(first, last);
+}
+
+/*
+ * Separator pushed up by a leaf split, any key in (left, right] works
+ */
+template <typename KeyType>
+inline KeyType ShortestSeparator(const KeyType &, const KeyType &right) {
+  return right;
+}
+
+// right cut after the first byte that differs from left, zero padded: still
+// greater than left and at most right, with as long a zero tail as possible
+template <size_t KeySize>
+inline GenericKey<KeySize> ShortestSeparator(const GenericKey<KeySize> &left,
+                                             const GenericKey<KeySize> &right) {
+  GenericKey<KeySize> key = right;
+  int n = CommonPrefixSize(left, right);
+  if (n + 1 < static_cast<int>(KeySize))
+    memset(key.data + n + 1, 0, KeySize - n - 1);
+  return key;
+}
+
+/*
+ * Return the first index i in [0, n) so that the key of entry i of a prefix
+ * layout page is >= key (> key if upper), n if none. Entry i starts at
+ * entries + i * stride with the key bytes after the page prefix.
+ */
+template <typename KeyType>
+inline int PrefixKeyBound(const char *prefix, int prefix_size,
+                          const char *entries, int stride, int n,
+                          const KeyType &key, bool upper) {
+  const char *bytes = reinterpret_cast<const char *>(&key);
+  // the prefix decides for every entry at once
+  int c = memcmp(prefix, bytes, prefix_size);
+  if (c != 0)
+    return c > 0 ? 0 : n;
+  bytes += prefix_size;
+  int suffix_size = sizeof(KeyType) - prefix_size;
+  int l = 0, r = n;
+  while (l < r) {
+    int mid = (l + r) / 2;
+    c = memcmp(entries + mid * stride, bytes, suffix_size);
+    if (c < 0 || (upper && c == 0))
+      l = mid + 1;
+    else
+      r = mid;
+  }
+  return l;
+}
+
+/*
+ * Number of key bytes up to the last non zero one. The zero bytes after it
+ * are padding (see GenericKey), a memcmp ordered key is restored from the
+ * rest by zero filling.
+ */
+template <typename KeyType> inline int KeyBytesSize(const KeyType &key) {
+  const char *bytes = reinterpret_cast<const char *>(&key);
+  int n = sizeof(KeyType);
+  while (n > 0 && bytes[n - 1] == 0)
+    n--;
+  return n;
+}
+
+/*
+ * Same as PrefixKeyBound for a slotted layout page: the key bytes after the
+ * page prefix of entry i are stored at page + slots[2 * i] with
+ * slots[2 * i + 1] bytes, the rest of the key is zero. Comparing the stored
+ * bytes with the bytes of key without its zero tail orders them as the full
+ * keys.
+ */
+template <typename KeyType>
+inline int SlottedKeyBound(const char *prefix, int prefix_size,
+                           const char *page, const uint16_t *slots, int n,
+                           const KeyType &key, bool upper) {
+  const char *bytes = reinterpret_cast<const char *>(&key);
+  int c = memcmp(prefix, bytes, prefix_size);
+  if (c != 0)
+    return c > 0 ? 0 : n;
+  bytes += prefix_size;
+  int suffix_size = std::max(KeyBytesSize(key) - prefix_size, 0);
+  int l = 0, r = n;
+  while (l < r) {
+    int mid = (l + r) / 2;
+    int size = slots[2 * mid + 1];
+    c = memcmp(page + slots[2 * mid], bytes, std::min(size, suffix_size));
+    if (c == 0)
+      c = size - suffix_size;
+    if (c < 0 || (upper && c == 0))
+      l = mid + 1;
+    else
+      r = mid;
+  }
+  return l;
+}
+
+} // namespace scudb
@@ -3,25 +3,56 @@
  *
  * Store indexed key and record id(record id = page id combined with slot id,
  * see include/common/rid.h for detailed implementation) together within leaf
- * page. Only support unique key.
+ * page. Keys are unique within a leaf, a non-unique tree stores a posting list
+ * reference as the value of a duplicate key (see BPlusTreePostingPage).
 
  * Leaf page format (keys are stored in order):
  *  ----------------------------------------------------------------------
  * | HEADER | KEY(1) + RID(1) | KEY(2) + RID(2) | ... | KEY(n) + RID(n)
  *  ----------------------------------------------------------------------
  *
- *  Header format (size in byte, 24 bytes in total):
+ * Columnar layout (see BPlusTreePage::IsColumnarLayout), keys and rids each
+ * fill a fixed share of the page so that keys are searched contiguously:
+ *  ----------------------------------------------------------------------
+ * | HEADER | KEY(1) | ... | KEY(capacity) | RID(1) | ... | RID(capacity) |
+ *  ----------------------------------------------------------------------
+ *
+ * Prefix layout (see BPlusTreePage::IsPrefixLayout), the first PrefixSize
+ * bytes of every key are stored once and each entry keeps the rest of its
+ * key, so the capacity grows with the prefix:
+ *  ----------------------------------------------------------------------
+ * | HEADER | PrefixSize (2) | PREFIX | SUFFIX(1) + RID(1) | ... |
+ *  ----------------------------------------------------------------------
+ * The prefix is shared by the whole key range the parent page routes to this
+ * page, not just by the keys stored now, so an insert never shortens it.
+ * Only a page that takes over keys of a sibling gives up the part of the
+ * prefix the sibling does not share.
+ *
+ * Slotted layout (see BPlusTreePage::IsSlottedLayout), a prefix layout whose
+ * entries keep their key bytes without the page prefix and the zero padding.
+ * A slot directory, ordered by key, grows from the front and points at the
+ * entries in a heap growing from the back, same as TablePage:
+ *  ----------------------------------------------------------------------
+ * | HEADER | PrefixSize (2) | FreeSpacePointer (2) | PREFIX | SLOT(1) ...
+ *  ----------------------------------------------------------------------
+ *  ----------------------------------------------------------------------
+ * | ... SLOT(n) | ... FREE SPACE ... | SUFFIX(n) + RID(n) | ... (1) |
+ *  ----------------------------------------------------------------------
+ * SLOT = Offset (2) + SuffixSize (2). Max size is the entry count once the
+ * free space fits only one more entry of the longest key, so it grows as
+ * short keys come in.
+ *
+ *  Header format (size in byte, 28 bytes in total):
  *  ---------------------------------------------------------------------
- * | PageType (4) | CurrentSize (4) | MaxSize (4) | ParentPageId (4) |
+ * | page header (20) | NextPageId (4) | PrevPageId (4) |
  *  ---------------------------------------------------------------------
- *  ------------------------------
- * | PageId (4) | NextPageId (4)
- *  ------------------------------
+ * page header is the BPlusTreePage header, see b_plus_tree_page.h
  */
 #pragma once
 #include <utility>
 #include <vector>
 
+#include "page/b_plus_tree_key_search.h"
 #include "page/b_plus_tree_page.h"
 
 namespace scudb {
@@ -34,30 +65,60 @@ class BPlusTreeLeafPage : public BPlusTreePage {
 public:
   // After creating a new leaf page from buffer pool, must call initialize
   // method to set default values
-  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID);
+  // prefix: prefix layout, kept as row layout for keys not ordered by memcmp
+  // slotted: slotted layout, same condition
+  void Init(page_id_t page_id, bool columnar = false, bool prefix = false,
+            bool slotted = false, KeySearch search = KeySearch::BINARY);
   // helper methods
   page_id_t GetNextPageId() const;
   void SetNextPageId(page_id_t next_page_id);
+  page_id_t GetPrevPageId() const;
+  void SetPrevPageId(page_id_t prev_page_id);
   KeyType KeyAt(int index) const;
   int KeyIndex(const KeyType &key, const KeyComparator &comparator) const;
-  const MappingType &GetItem(int index);
+  // adaptive key search: interpolate from now on if the keys are evenly
+  // spread, called when entries move in bulk (split, merge, bulk load)
+  void SampleKeySearch();
+  MappingType GetItem(int index);
 
   // insert and delete methods
   int Insert(const KeyType &key, const ValueType &value,
              const KeyComparator &comparator);
   bool Lookup(const KeyType &key, ValueType &value,
               const KeyComparator &comparator) const;
+  bool SetValue(const KeyType &key, const ValueType &value,
+                const KeyComparator &comparator);
   int RemoveAndDeleteRecord(const KeyType &key,
                             const KeyComparator &comparator);
+  int RemoveRange(int from, int to);
+  // prefix layout: re-encode keys with the prefix shared by [low, high], the
+  // key range of this page; a null bound is the lowest (highest) key sharing
+  // the current prefix
+  void SetKeyRange(const KeyType *low, const KeyType *high);
+  int GetPrefixSize() const;
+  // max size of this page after taking over all entries of sibling
+  int MaxSizeWith(const BPlusTreeLeafPage *sibling) const;
+  // whether a bulk load moves on to the next page, at fill_factor of the
+  // max size (of the space of a slotted page)
+  bool IsFilled(double fill_factor) const;
   // Split and Merge utility methods
+  // keep: entries left in this page, half of them if -1
   void MoveHalfTo(BPlusTreeLeafPage *recipient,
-                  BufferPoolManager *buffer_pool_manager /* Unused */);
-  void MoveAllTo(BPlusTreeLeafPage *recipient, int /* Unused */,
+                  BufferPoolManager *buffer_pool_manager /* Unused */,
+                  int keep = -1);
+  void MoveAllTo(BPlusTreeLeafPage *recipient,
+                 const KeyType & /* Unused */,
                  BufferPoolManager * /* Unused */);
   void MoveFirstToEndOf(BPlusTreeLeafPage *recipient,
-                        BufferPoolManager *buffer_pool_manager);
-  void MoveLastToFrontOf(BPlusTreeLeafPage *recipient, int parentIndex,
-                         BufferPoolManager *buffer_pool_manager);
+                        const KeyType & /* Unused */,
+                        BufferPoolManager * /* Unused */);
+  void MoveLastToFrontOf(BPlusTreeLeafPage *recipient,
+                         const KeyType & /* Unused */,
+                         BufferPoolManager * /* Unused */);
+  // B-link support, the last array slot holds the high key
+  void ReserveHighKey();
+  KeyType GetHighKey() const;
+  void SetHighKey(const KeyType &key);
   // Debug
   std::string ToString(bool verbose = false) const;
 
@@ -65,9 +126,109 @@ private:
   void CopyHalfFrom(MappingType *items, int size);
   void CopyAllFrom(MappingType *items, int size);
   void CopyLastFrom(const MappingType &item);
-  void CopyFirstFrom(const MappingType &item, int parentIndex,
-                     BufferPoolManager *buffer_pool_manager);
+  void CopyFirstFrom(const MappingType &item);
+  // entry access for all layouts
+  int Capacity() const {
+    if (IsSlottedLayout())
+      return GetSize() + (FreeSpacePointer() - SlotsOffset(PrefixSize()) -
+                          GetSize() * SlotSize()) /
+                             SlottedEntrySize(PrefixSize());
+    if (IsPrefixLayout())
+      return PrefixCapacity(PrefixSize());
+    return IsColumnarLayout()
+               ? (PAGE_SIZE - sizeof(BPlusTreeLeafPage)) /
+                     (sizeof(KeyType) + sizeof(ValueType))
+               : (PAGE_SIZE - sizeof(BPlusTreeLeafPage)) / sizeof(MappingType);
+  }
+  static int PrefixCapacity(int prefix_size) {
+    return (PAGE_SIZE - sizeof(BPlusTreeLeafPage) - sizeof(uint16_t) -
+            prefix_size) /
+           (sizeof(KeyType) - prefix_size + sizeof(ValueType));
+  }
+  int PrefixSize() const {
+    return *reinterpret_cast<const uint16_t *>(array);
+  }
+  // a slotted page keeps its free space pointer right after the prefix size
+  int PrefixOffset() const {
+    return (IsSlottedLayout() ? 2 : 1) * sizeof(uint16_t);
+  }
+  char *Prefix() { return reinterpret_cast<char *>(array) + PrefixOffset(); }
+  const char *Prefix() const {
+    return reinterpret_cast<const char *>(array) + PrefixOffset();
+  }
+  int EntrySize() const {
+    return sizeof(KeyType) - PrefixSize() + sizeof(ValueType);
+  }
+  char *Entry(int index) { return Prefix() + PrefixSize() + index * EntrySize(); }
+  const char *Entry(int index) const {
+    return Prefix() + PrefixSize() + index * EntrySize();
+  }
+  // slotted layout: a slot is the offset of an entry in the page and the
+  // size of its key suffix, the value follows the suffix
+  static int SlotSize() { return 2 * sizeof(uint16_t); }
+  static int SlotsOffset(int prefix_size) {
+    int offset = sizeof(BPlusTreeLeafPage) + 2 * sizeof(uint16_t) + prefix_size;
+    return (offset + 1) & ~1;
+  }
+  // room an entry of the longest key takes, slot included
+  static int SlottedEntrySize(int prefix_size) {
+    return SlotSize() + sizeof(KeyType) - prefix_size + sizeof(ValueType);
+  }
+  uint16_t &FreeSpacePointer() {
+    return reinterpret_cast<uint16_t *>(array)[1];
+  }
+  uint16_t FreeSpacePointer() const {
+    return reinterpret_cast<const uint16_t *>(array)[1];
+  }
+  uint16_t *Slots() {
+    return reinterpret_cast<uint16_t *>(reinterpret_cast<char *>(this) +
+                                        SlotsOffset(PrefixSize()));
+  }
+  const uint16_t *Slots() const {
+    return const_cast<BPlusTreeLeafPage *>(this)->Slots();
+  }
+  char *Record(int index) {
+    return reinterpret_cast<char *>(this) + Slots()[2 * index];
+  }
+  const char *Record(int index) const {
+    return reinterpret_cast<const char *>(this) + Slots()[2 * index];
+  }
+  KeyType *Keys() { return reinterpret_cast<KeyType *>(array); }
+  const KeyType *Keys() const {
+    return reinterpret_cast<const KeyType *>(array);
+  }
+  ValueType *Values() {
+    return reinterpret_cast<ValueType *>(Keys() + Capacity());
+  }
+  KeyType &KeySlot(int index) {
+    return IsColumnarLayout() ? Keys()[index] : array[index].first;
+  }
+  const KeyType &KeySlot(int index) const {
+    return IsColumnarLayout() ? Keys()[index] : array[index].first;
+  }
+  ValueType &ValueSlot(int index) {
+    return IsColumnarLayout() ? Values()[index] : array[index].second;
+  }
+  const ValueType &ValueSlot(int index) const {
+    return const_cast<BPlusTreeLeafPage *>(this)->ValueSlot(index);
+  }
+  // copies of a key or value, any layout
+  KeyType LoadKey(int index) const;
+  void StoreKey(int index, const KeyType &key);
+  ValueType LoadValue(int index) const;
+  void StoreValue(int index, const ValueType &value);
+  void MoveSlots(BPlusTreeLeafPage *recipient, int to, int from, int n);
+  void SetPrefix(const char *prefix, int prefix_size);
+  // prefix bytes shared with other, 0 unless both are prefix layout
+  int SharedPrefixSize(const BPlusTreeLeafPage *other) const;
+  void SharePrefixWith(const BPlusTreeLeafPage *other);
+  // bytes the entries take in a slotted page with the first prefix_size
+  // bytes of the prefix, slots included
+  int SlottedBytes(int prefix_size) const;
+  void Reclaim();
   page_id_t next_page_id_;
+  // left sibling, for reverse scans (see ReverseIndexIterator)
+  page_id_t prev_page_id_;
   MappingType array[0];
 };
 } // namespace scudb
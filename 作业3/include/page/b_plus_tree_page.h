@@ -8,9 +8,11 @@
  *
  * Header format (size in byte, 20 bytes in total):
  * ----------------------------------------------------------------------------
- * | PageType (4) | LSN (4) | CurrentSize (4) | MaxSize (4) |
+ * | PageType (1) + Counted (1) + Version (2) | LSN (4) | CurrentSize (4) |
  * ----------------------------------------------------------------------------
- * | ParentPageId (4) | PageId(4) |
+ * | MaxSize (2) + KeySearch (1) + Interpolate (1) |
+ * ----------------------------------------------------------------------------
+ * | IsRoot (1) + Layout (1) + MinSize (2) | PageId(4) |
  * ----------------------------------------------------------------------------
  */
 
@@ -18,11 +20,13 @@
 
 #include <cassert>
 #include <climits>
+#include <cstdint>
 #include <cstdlib>
 #include <string>
 
 #include "buffer/buffer_pool_manager.h"
 #include "index/generic_key.h"
+#include "index/integer_key.h"
 
 namespace scudb {
 
@@ -32,40 +36,87 @@ namespace scudb {
   template <typename KeyType, typename ValueType, typename KeyComparator>
 
 // define page type enum
-enum class IndexPageType { INVALID_INDEX_PAGE = 0, LEAF_PAGE, INTERNAL_PAGE };
+enum class IndexPageType : uint8_t {
+  INVALID_INDEX_PAGE = 0,
+  LEAF_PAGE,
+  INTERNAL_PAGE
+};
 enum class OpType{SEARCH=0,INSERT,DELETE};
+// entry array layout of a page, fixed at page Init
+enum class PageLayout : uint8_t { ROW = 0, COLUMNAR, PREFIX, SLOTTED };
+// key search inside a page, fixed at page Init: binary, interpolation (see
+// InterpolationKeyBound), or either one as a sample of the keys suggests
+enum class KeySearch : uint8_t { BINARY = 0, INTERPOLATION, ADAPTIVE };
 // Abstract class.
 class BPlusTreePage {
 public:
   bool IsLeafPage() const;
   bool IsRootPage() const;
+  void SetRootPage(bool is_root);
+  bool IsColumnarLayout() const;
+  void SetColumnarLayout(bool columnar);
+  bool IsPrefixLayout() const;
+  void SetPrefixLayout(bool prefix);
+  bool IsSlottedLayout() const;
+  void SetSlottedLayout(bool slotted);
+  bool IsCounted() const;
+  void SetCounted(bool counted);
+  KeySearch GetKeySearch() const;
+  void SetKeySearch(KeySearch search);
+  // whether searches of this page start with an interpolation guess, only
+  // row and columnar layouts do
+  bool IsInterpolated() const;
+  // adaptive key search only, the outcome of a sample of the keys
+  void SetInterpolated(bool interpolate);
   void SetPageType(IndexPageType page_type);
 
   int GetSize() const;
   void SetSize(int size);
   void IncreaseSize(int amount);
+  uint16_t GetVersion() const;
 
   int GetMaxSize() const;
   void SetMaxSize(int max_size);
   int GetMinSize() const;
-
-  page_id_t GetParentPageId() const;
-  void SetParentPageId(page_id_t parent_page_id);
+  void SetMinSize(int min_size);
 
   page_id_t GetPageId() const;
   void SetPageId(page_id_t page_id);
 
   void SetLSN(lsn_t lsn = INVALID_LSN);
   
-  bool IsSafe(OpType optype);
+  // min_size: the size a non-root page is merged below, GetMinSize() if -1
+  bool IsSafe(OpType optype, int min_size = -1);
 
 private:
   // member variable, attributes that both internal and leaf page share
   IndexPageType page_type_;
+  // internal page only: every child pointer carries the number of leaf
+  // entries below it (see BPlusTreeInternalPage::CountAt)
+  bool counted_;
+  // changes whenever entries move between slots of the page, which is every
+  // change of its size; wraps around (see AdaptiveHash)
+  uint16_t version_;
   lsn_t lsn_;
   int size_;
-  int max_size_;
-  page_id_t parent_page_id_;
+  uint16_t max_size_;
+  KeySearch key_search_;
+  // adaptive key search only: the last sample of the keys was evenly spread
+  // (see SampleKeySearch of the leaf and internal page)
+  bool interpolate_;
+  // no parent page id: it would have to be rewritten in every child moved by a
+  // split or merge, the tree tracks the root-to-leaf path instead
+  bool is_root_;
+  // row layout stores key & value pairs, columnar layout stores all keys
+  // followed by all values so that a search scans keys only, prefix layout
+  // stores key & value pairs with the key prefix shared by the whole key
+  // range of the page factored out (see BPlusTreeLeafPage), slotted layout
+  // is a prefix layout leaf with variable length keys
+  PageLayout layout_;
+  // prefix layout only: max size grows with the prefix (and shrinks with the
+  // key bytes of a slotted page), min size stays at half of the max size
+  // without prefix
+  uint16_t min_size_;
   page_id_t page_id_;
 };
 
@@ -0,0 +1,68 @@
+/**
+ * b_plus_tree_posting_page.h
+ *
+ * Posting list page of a non-unique B+ tree. A key with more than one record
+ * id keeps a single leaf entry whose value refers to a chain of posting pages
+ * (see MakeReference) holding all of its record ids in increasing order. A
+ * key with one record id stores it in the leaf directly.
+ *
+ * Posting pages are only reachable through their leaf entry, so the latch on
+ * the leaf page protects the whole chain.
+ *
+ * Posting page format (record ids are stored in order, and every record id
+ * of a page is smaller than those of the next page):
+ *  ----------------------------------------------------------------------
+ * | HEADER | RID(1) | RID(2) | ... | RID(n) |
+ *  ----------------------------------------------------------------------
+ *
+ *  Header format (size in byte, 16 bytes in total):
+ *  ---------------------------------------------------------------------
+ * | PageId (4) | LSN (4) | CurrentSize (4) | NextPageId (4) |
+ *  ---------------------------------------------------------------------
+ */
+#pragma once
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/rid.h"
+
+namespace scudb {
+
+class BPlusTreePostingPage {
+public:
+  // After creating a new posting page from buffer pool, must call initialize
+  // method to set default values
+  void Init(page_id_t page_id);
+  page_id_t GetPageId() const;
+  void SetLSN(lsn_t lsn = INVALID_LSN);
+  int GetSize() const;
+  int GetMaxSize() const;
+  page_id_t GetNextPageId() const;
+  void SetNextPageId(page_id_t next_page_id);
+  RID RIDAt(int index) const;
+
+  // insert and delete methods, false if rid exists / does not exist
+  bool Contains(const RID &rid) const;
+  bool Insert(const RID &rid);
+  bool Remove(const RID &rid);
+  // split, recipient is linked in right after this page
+  void MoveHalfTo(BPlusTreePostingPage *recipient);
+
+  // leaf entry value that refers to the posting list starting at page_id
+  static RID MakeReference(page_id_t page_id) {
+    return RID(page_id, REFERENCE_SLOT_NUM);
+  }
+  static bool IsReference(const RID &rid) {
+    return rid.GetSlotNum() == REFERENCE_SLOT_NUM;
+  }
+
+private:
+  // not a valid slot number of a table page
+  static const int REFERENCE_SLOT_NUM = -2;
+  int RIDIndex(const RID &rid) const;
+  page_id_t page_id_;
+  lsn_t lsn_;
+  int size_;
+  page_id_t next_page_id_;
+  RID array[0];
+};
+} // namespace scudb
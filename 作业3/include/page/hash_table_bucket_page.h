@@ -0,0 +1,62 @@
+/**
+ * hash_table_bucket_page.h
+ *
+ * Bucket page of the disk-resident extendible hash index. Stores unsorted key &
+ * record id pairs whose hash values share the bucket's low LocalDepth bits.
+ * Only support unique key.
+ *
+ * Bucket page format:
+ *  ----------------------------------------------------------------------
+ * | HEADER | KEY(1) + RID(1) | KEY(2) + RID(2) | ... | KEY(n) + RID(n)
+ *  ----------------------------------------------------------------------
+ *
+ *  Header format (size in byte, 16 bytes in total):
+ *  ---------------------------------------------------------------------
+ * | PageId (4) | LSN (4) | CurrentSize (4) | MaxSize (4) |
+ *  ---------------------------------------------------------------------
+ */
+#pragma once
+
+#include <utility>
+#include <vector>
+
+// INDEX_TEMPLATE_ARGUMENTS and MappingType
+#include "page/b_plus_tree_page.h"
+
+namespace scudb {
+#define HASH_TABLE_BUCKET_PAGE_TYPE                                            \
+  HashTableBucketPage<KeyType, ValueType, KeyComparator>
+
+INDEX_TEMPLATE_ARGUMENTS
+class HashTableBucketPage {
+public:
+  // After creating a new bucket page from buffer pool, must call initialize
+  // method to set default values
+  void Init(page_id_t page_id);
+  page_id_t GetPageId() const;
+  void SetLSN(lsn_t lsn = INVALID_LSN);
+  int GetSize() const;
+  int GetMaxSize() const;
+  bool IsFull() const;
+
+  KeyType KeyAt(int index) const;
+  ValueType ValueAt(int index) const;
+
+  // insert, lookup and delete methods
+  bool Insert(const KeyType &key, const ValueType &value,
+              const KeyComparator &comparator);
+  bool Lookup(const KeyType &key, ValueType &value,
+              const KeyComparator &comparator) const;
+  bool Remove(const KeyType &key, const KeyComparator &comparator);
+  // remove the entry at index, last entry takes its place
+  void RemoveAt(int index);
+
+private:
+  int KeyIndex(const KeyType &key, const KeyComparator &comparator) const;
+  page_id_t page_id_;
+  lsn_t lsn_;
+  int size_;
+  int max_size_;
+  MappingType array[0];
+};
+} // namespace scudb
@@ -0,0 +1,59 @@
+/**
+ * hash_table_directory_page.h
+ *
+ * Directory page of the disk-resident extendible hash index. It plays the role
+ * of ExtendibleHash::bucketTable: slot i holds the page id of the bucket for
+ * hash values whose low GlobalDepth bits equal i, plus that bucket's local
+ * depth.
+ *
+ * Directory page format (size in byte):
+ *  --------------------------------------------------------------------------
+ * | PageId (4) | LSN (4) | GlobalDepth (4) | BucketPageId(0) (4) | ... |
+ *  --------------------------------------------------------------------------
+ *  ----------------------------------------------
+ * | ... | LocalDepth(0) (1) | LocalDepth(1) (1) | ... |
+ *  ----------------------------------------------
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "common/config.h"
+
+namespace scudb {
+
+#define DIRECTORY_ARRAY_SIZE                                                   \
+  ((PAGE_SIZE - 3 * sizeof(int32_t)) / (sizeof(page_id_t) + sizeof(uint8_t)))
+
+class HashTableDirectoryPage {
+public:
+  // must call initialize method after "create" a new directory page
+  void Init(page_id_t page_id);
+
+  page_id_t GetPageId() const;
+  void SetLSN(lsn_t lsn = INVALID_LSN);
+
+  // global depth helpers
+  int GetGlobalDepth() const;
+  uint32_t GetGlobalDepthMask() const;
+  int GetMaxDepth() const;
+  bool CanGrow() const;
+  void IncrGlobalDepth();
+  int Size() const;
+
+  // per slot helpers
+  page_id_t GetBucketPageId(int index) const;
+  void SetBucketPageId(int index, page_id_t bucket_page_id);
+  int GetLocalDepth(int index) const;
+  void SetLocalDepth(int index, int local_depth);
+
+private:
+  page_id_t page_id_;
+  lsn_t lsn_;
+  int32_t global_depth_;
+  page_id_t bucket_page_ids_[DIRECTORY_ARRAY_SIZE];
+  uint8_t local_depths_[DIRECTORY_ARRAY_SIZE];
+};
+
+} // namespace scudb
@@ -0,0 +1,117 @@
+/**
+ * adaptive_hash.cpp
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "index/adaptive_hash.h"
+#include "index/generic_key.h"
+#include "index/integer_key.h"
+
+namespace scudb {
+
+// heat of a key stops growing there, so that a key that went cold gives its
+// bucket up after as many searches of other keys
+static const int MAX_HEAT_FACTOR = 2;
+
+template <typename KeyType>
+AdaptiveHash<KeyType>::AdaptiveHash(size_t buckets, int threshold)
+    : threshold_(std::max(threshold, 1)), epoch_(0), searches_(0), hits_(0) {
+  size_t size = 1;
+  while (size < buckets)
+    size <<= 1;
+  buckets_.resize(size);
+  for (Bucket &bucket : buckets_) {
+    bucket.heat = 0;
+    bucket.stored = false;
+  }
+  mask_ = size - 1;
+}
+
+/*
+ * helper function to calculate the bucket of input key, FNV-1a over the raw
+ * key bytes as in ExtendibleHashIndex::HashKey
+ */
+template <typename KeyType>
+uint32_t AdaptiveHash<KeyType>::HashKey(const KeyType &key) const {
+  const unsigned char *data = reinterpret_cast<const unsigned char *>(&key);
+  uint32_t hash = 2166136261U;
+  for (size_t i = 0; i < sizeof(KeyType); i++) {
+    hash ^= data[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+template <typename KeyType>
+bool AdaptiveHash<KeyType>::IsKeyOf(const Bucket &bucket,
+                                    const KeyType &key) const {
+  return bucket.heat > 0 && memcmp(&bucket.key, &key, sizeof(KeyType)) == 0;
+}
+
+/*
+ * A stored position of an earlier epoch is dropped. A hit heats the key up
+ * like a descent would, a hot key served from the table stays hot.
+ */
+template <typename KeyType>
+bool AdaptiveHash<KeyType>::Lookup(const KeyType &key, Position &position) {
+  searches_.fetch_add(1, std::memory_order_relaxed);
+  size_t index = HashKey(key) & mask_;
+  Bucket &bucket = buckets_[index];
+  std::lock_guard<std::mutex> guard(latches_[index & (LATCHES - 1)]);
+  if (!IsKeyOf(bucket, key) || !bucket.stored)
+    return false;
+  if (bucket.position.epoch != epoch_) {
+    bucket.stored = false;
+    return false;
+  }
+  if (bucket.heat < threshold_ * MAX_HEAT_FACTOR)
+    bucket.heat++;
+  position = bucket.position;
+  return true;
+}
+
+template <typename KeyType>
+bool AdaptiveHash<KeyType>::Notice(const KeyType &key) {
+  size_t index = HashKey(key) & mask_;
+  Bucket &bucket = buckets_[index];
+  std::lock_guard<std::mutex> guard(latches_[index & (LATCHES - 1)]);
+  if (IsKeyOf(bucket, key)) {
+    if (bucket.heat < threshold_ * MAX_HEAT_FACTOR)
+      bucket.heat++;
+  } else if (bucket.heat > 0) {
+    bucket.heat--;
+    return false;
+  } else {
+    bucket.key = key;
+    bucket.heat = 1;
+    bucket.stored = false;
+  }
+  return bucket.heat >= threshold_;
+}
+
+/*
+ * Nothing is stored if key has lost its bucket since Notice
+ */
+template <typename KeyType>
+void AdaptiveHash<KeyType>::Store(const KeyType &key,
+                                  const Position &position) {
+  size_t index = HashKey(key) & mask_;
+  Bucket &bucket = buckets_[index];
+  std::lock_guard<std::mutex> guard(latches_[index & (LATCHES - 1)]);
+  if (IsKeyOf(bucket, key)) {
+    bucket.position = position;
+    bucket.stored = true;
+  }
+}
+
+template class AdaptiveHash<GenericKey<4>>;
+template class AdaptiveHash<GenericKey<8>>;
+template class AdaptiveHash<GenericKey<16>>;
+template class AdaptiveHash<GenericKey<32>>;
+template class AdaptiveHash<GenericKey<64>>;
+template class AdaptiveHash<IntegerKey<int32_t>>;
+template class AdaptiveHash<IntegerKey<int64_t>>;
+
+} // namespace scudb
@@ -1,8 +1,11 @@
 /**
  * b_plus_tree.cpp
  */
+#include <algorithm>
+#include <exception>
 #include <iostream>
 #include <string>
+#include <thread>
 
 #include "common/exception.h"
 #include "common/logger.h"
@@ -12,13 +15,33 @@
 
 namespace scudb {
 
+void BPlusTreeOptions::Validate() const {
+  // the high key slot and the columnar arrays assume fixed size entries
+  if ((prefix || slotted) && (blink || columnar))
+    throw Exception(EXCEPTION_TYPE_INDEX,
+                    "prefix layout can not be combined with B-link or columnar");
+  // a B-link split publishes the new page before its parent knows it
+  if (counted && blink)
+    throw Exception(EXCEPTION_TYPE_INDEX,
+                    "subtree counts can not be combined with B-link");
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(const std::string &name,
                           BufferPoolManager *buffer_pool_manager,
                           const KeyComparator &comparator,
-                          page_id_t root_page_id)
+                          page_id_t root_page_id,
+                          const BPlusTreeOptions &options)
         : index_name_(name), root_page_id_(root_page_id),
-          buffer_pool_manager_(buffer_pool_manager), comparator_(comparator) {}
+          buffer_pool_manager_(buffer_pool_manager), comparator_(comparator),
+          blink_(options.blink), columnar_(options.columnar),
+          unique_(options.unique),
+          prefix_(options.prefix || options.slotted),
+          slotted_(options.slotted), counted_(options.counted),
+          key_search_(options.key_search),
+          rightmost_leaf_(INVALID_PAGE_ID), has_pending_free_(false) {
+  options.Validate();
+}
 
 /*
  * Helper function to decide whether current b+tree is empty
@@ -37,7 +60,8 @@ thread_local int BPlusTree<KeyType, ValueType, KeyComparator>::rootLockedCnt = 0
  * SEARCH
  *****************************************************************************/
 /*
- * Return the only value that associated with input key
+ * Return the values that associated with input key (only one for a unique
+ * tree), in record id order for a posting list
  * This method is used for point query
  * @return : true means key exists
  */
@@ -45,17 +69,254 @@ INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::GetValue(const KeyType &key,
                               std::vector<ValueType> &result,
                               Transaction *transaction) {
+  result.clear();
+  if (bloom_filter_ != nullptr && !bloom_filter_->MayContain(key))
+    return false;
+  if (adaptive_hash_ != nullptr && AdaptiveHashGetValue(key,result))
+    return true;
+  ValueType v;
+  if (blink_) {
+    Page *page = BLinkFindLeafPage(key,false,false,nullptr);
+    if (page == nullptr)
+      return false;
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+    bool r = leaf->Lookup(key,v,comparator_);
+    if (r)
+      GetPostings(v,result);
+    if (r && adaptive_hash_ != nullptr)
+      AdaptiveHashNotice(leaf,key);
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    return r;
+  }
   B_PLUS_TREE_LEAF_PAGE_TYPE *t = FindLeafPage(key,false,OpType::SEARCH,transaction);
   if (t == nullptr)
     return false;
   else{
+    // read the leaf (and its posting list) before releasing it
+    bool r = t->Lookup(key,v,comparator_);
+    if (r)
+      GetPostings(v,result);
+    if (r && adaptive_hash_ != nullptr)
+      AdaptiveHashNotice(t,key);
     FreePagesInTransaction(false,transaction,t->GetPageId());
-    result.resize(1);
-    bool r = t->Lookup(key,result[0],comparator_);
     return r;
   }
 }
 
+/*****************************************************************************
+ * ADAPTIVE HASH INDEX
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::EnableAdaptiveHash(size_t buckets, int threshold) {
+  adaptive_hash_.reset(new AdaptiveHash<KeyType>(buckets,threshold));
+}
+
+/*
+ * GetValue of a hot key from its stored position. The position is checked
+ * under the read latch of its page: the table must still be in the epoch of
+ * the position (the page was not freed since), and the page must be a leaf
+ * of the same version holding key at that slot.
+ * @return : false means caller takes the normal descent
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::AdaptiveHashGetValue(const KeyType &key,
+                                          std::vector<ValueType> &result) {
+  typename AdaptiveHash<KeyType>::Position position;
+  if (!adaptive_hash_->Lookup(key,position))
+    return false;
+  Page *page = buffer_pool_manager_->FetchPage(position.page_id);
+  if (page == nullptr)
+    return false;
+  page->RLatch();
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  bool hit = position.epoch == adaptive_hash_->Epoch() &&
+             leaf->IsLeafPage() && leaf->GetVersion() == position.version &&
+             position.slot < leaf->GetSize();
+  if (hit) {
+    MappingType item = leaf->GetItem(position.slot);
+    hit = comparator_(item.first,key) == 0;
+    if (hit)
+      GetPostings(item.second,result);
+  }
+  page->RUnlatch();
+  ReleasePage(position.page_id,false);
+  if (hit)
+    adaptive_hash_->CountHit();
+  return hit;
+}
+
+/*
+ * Called by GetValue with the read latch of the leaf holding key
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::AdaptiveHashNotice(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf,
+                                        const KeyType &key) {
+  if (!adaptive_hash_->Notice(key))
+    return;
+  typename AdaptiveHash<KeyType>::Position position;
+  position.page_id = leaf->GetPageId();
+  position.slot = leaf->KeyIndex(key,comparator_);
+  position.version = leaf->GetVersion();
+  position.epoch = adaptive_hash_->Epoch();
+  adaptive_hash_->Store(key,position);
+}
+
+/*****************************************************************************
+ * BLOOM FILTER
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::EnableBloomFilter(size_t keys, double fp_rate) {
+  bloom_filter_.reset(new BloomFilter<KeyType>(keys,fp_rate));
+  if (!IsEmpty())
+    RebuildBloomFilter();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::IsBloomFilterStale() const {
+  return bloom_filter_ != nullptr && bloom_filter_->IsStale(bloomRebuildRatio);
+}
+
+/*
+ * Scan the leaves in key order, readers and writers go on meanwhile (see
+ * BloomFilter::Rebuild). The values of a posting list come one pair each,
+ * their key is added once.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::RebuildBloomFilter() {
+  if (bloom_filter_ == nullptr)
+    return 0;
+  size_t keys = 0;
+  bloom_filter_->Rebuild([&](const std::function<void(const KeyType &)> &add) {
+    KeyType last;
+    ParallelScan(1,4096,[&](size_t, const std::vector<MappingType> &batch) {
+      for (const MappingType &item : batch) {
+        if (keys > 0 && comparator_(item.first,last) == 0)
+          continue;
+        add(item.first);
+        last = item.first;
+        keys++;
+      }
+      return true;
+    });
+    return keys;
+  });
+  return keys;
+}
+
+/*
+ * Point query for a batch of keys, results[i] gets the values of keys[i]
+ * (empty if it does not exist). Lookups run in groups of multiGetGroup keys
+ * sorted by key, which descend the tree together one level at a time: the
+ * children of every lookup of the group are fetched from the buffer pool and
+ * prefetched into cache before any of them is searched, so the misses of one
+ * level overlap instead of forming one chain per key. Lookups reaching the
+ * same page share it.
+ * A group read latches a whole level at a time, left to right, before it
+ * releases the level above. Writers latch top-down and left to right too,
+ * and the group never asks again for a page it has released, so holding
+ * several latches does not deadlock with them. B-link mode runs GetValue
+ * for every key.
+ * @return : number of keys found
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::MultiGet(const std::vector<KeyType> &keys,
+                                std::vector<std::vector<ValueType>> &results) {
+  results.assign(keys.size(),std::vector<ValueType>());
+  size_t found = 0;
+  if (blink_) {
+    for (size_t i = 0; i < keys.size(); i++)
+      found += GetValue(keys[i],results[i]);
+    return found;
+  }
+  std::vector<size_t> order;
+  order.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (bloom_filter_ == nullptr || bloom_filter_->MayContain(keys[i]))
+      order.push_back(i);
+  }
+  std::stable_sort(order.begin(),order.end(),[&](size_t a, size_t b) {
+    return comparator_(keys[a],keys[b]) < 0;
+  });
+  size_t group = std::max<size_t>(1,multiGetGroup);
+  for (size_t begin = 0; begin < order.size(); begin += group) {
+    size_t end = std::min(order.size(),begin + group);
+    found += MultiGetGroup(keys,order.data() + begin,end - begin,results);
+  }
+  return found;
+}
+
+/*
+ * @param   order     indexes into keys of the n lookups of the group, in key
+ *                    order
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::MultiGetGroup(const std::vector<KeyType> &keys,
+                                     const size_t *order, size_t n,
+                                     std::vector<std::vector<ValueType>> &results) {
+  LockRootPageId(false);
+  if (IsEmpty()) {
+    TryUnlockRootPageId(false);
+    return 0;
+  }
+  Page *root = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (root == nullptr) {
+    TryUnlockRootPageId(false);
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  root->RLatch();
+  TryUnlockRootPageId(false);
+  // latched page of every lookup, lookups sharing a page are next to each
+  // other; a page is released at its first lookup
+  std::vector<Page *> pages(n,root), next(n);
+  auto release = [&](std::vector<Page *> &level) {
+    for (size_t j = 0; j < n; j++) {
+      if (j == 0 || level[j] != level[j - 1]) {
+        level[j]->RUnlatch();
+        buffer_pool_manager_->UnpinPage(level[j]->GetPageId(),false);
+      }
+    }
+  };
+  // the tree is balanced, all lookups reach the leaf level together
+  while (!reinterpret_cast<BPlusTreePage *>(pages[0]->GetData())->IsLeafPage()) {
+    for (size_t j = 0; j < n; j++) {
+      B_PLUS_TREE_INTERNAL_PAGE *internalPage = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(pages[j]->GetData());
+      page_id_t child = internalPage->Lookup(keys[order[j]],comparator_);
+      if (j > 0 && child == next[j - 1]->GetPageId()) {
+        next[j] = next[j - 1];
+        continue;
+      }
+      next[j] = buffer_pool_manager_->FetchPage(child);
+      if (next[j] == nullptr) {
+        for (size_t k = 0; k < j; k++) {
+          if (k == 0 || next[k] != next[k - 1])
+            buffer_pool_manager_->UnpinPage(next[k]->GetPageId(),false);
+        }
+        release(pages);
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      }
+      PrefetchPage(next[j]);
+    }
+    for (size_t j = 0; j < n; j++) {
+      if (j == 0 || next[j] != next[j - 1])
+        next[j]->RLatch();
+    }
+    release(pages);
+    pages.swap(next);
+  }
+  size_t found = 0;
+  for (size_t j = 0; j < n; j++) {
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(pages[j]->GetData());
+    ValueType v;
+    if (leaf->Lookup(keys[order[j]],v,comparator_)) {
+      GetPostings(v,results[order[j]]);
+      found++;
+    }
+  }
+  release(pages);
+  return found;
+}
+
 /*****************************************************************************
  * INSERTION
  *****************************************************************************/
@@ -63,23 +324,146 @@ bool BPLUSTREE_TYPE::GetValue(const KeyType &key,
  * Insert constant key & value pair into b+ tree
  * if current tree is empty, start new tree, update root page id and insert
  * entry, otherwise insert into leaf page.
- * @return: since we only support unique key, if user try to insert duplicate
- * keys return false, otherwise return true.
+ * @return: for a unique tree, if user try to insert duplicate keys return
+ * false; for a non-unique tree, return false only if the key & value pair
+ * exists. Otherwise return true.
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value,
                             Transaction *transaction) {
-  LockRootPageId(true);
-  if (IsEmpty()) {
-    StartNewTree(key,value);
+  std::shared_lock<std::shared_mutex> bloomGuard;
+  if (bloom_filter_ != nullptr) {
+    bloomGuard = bloom_filter_->GuardInsert();
+    bloom_filter_->Add(key);
+  }
+  return InsertEntry(key,value,transaction);
+}
+
+/*
+ * Insert without touching the Bloom filter, the caller has added key under
+ * its insert guard (see BloomFilter::GuardInsert, which can not be taken
+ * twice by one thread)
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::InsertEntry(const KeyType &key, const ValueType &value,
+                                 Transaction *transaction) {
+  // only an empty tree needs the root page id exclusively here
+  LockRootPageId(false);
+  bool empty = IsEmpty();
+  TryUnlockRootPageId(false);
+  if (empty) {
+    LockRootPageId(true);
+    if (IsEmpty()) {
+      StartNewTree(key,value);
+      TryUnlockRootPageId(true);
+      return true;
+    }
     TryUnlockRootPageId(true);
+  }
+  if (AppendToRightmostLeaf(key,value))
     return true;
+  if (blink_)
+    return BLinkInsert(key,value);
+  return InsertIntoLeaf(key,value,transaction);
+}
+/*
+ * Insert a batch of key & value pairs, sorted by key first so that pairs of
+ * the same leaf are next to each other. Each descent write latches the leaf of
+ * the first pending pair (read latches above it, like the optimistic insert)
+ * and applies the following pairs while they stay below the leaf's upper
+ * bound: the smallest separator on its right, or its high key in B-link mode.
+ * The bound can not move while the leaf is latched, since splits, merges and
+ * redistributions that change it all latch the leaf. A pair that would
+ * overflow the leaf goes through Insert, which splits it, and the next pair
+ * descends again.
+ * A counted tree inserts the pairs one by one, in key order: the counts on
+ * the path of a leaf change with every pair.
+ * @return: number of pairs inserted, pairs are rejected as in Insert()
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::InsertBatch(std::vector<MappingType> &items,
+                                   Transaction *transaction) {
+  std::stable_sort(items.begin(),items.end(),
+                   [this](const MappingType &a, const MappingType &b) {
+                     return comparator_(a.first,b.first) < 0;
+                   });
+  size_t inserted = 0;
+  size_t i = 0;
+  if (counted_) {
+    // Insert adds the keys to the Bloom filter
+    for (; i < items.size(); i++)
+      inserted += Insert(items[i].first,items[i].second,transaction);
+    return inserted;
   }
-  else{
-    TryUnlockRootPageId(true);
-    return InsertIntoLeaf(key,value,transaction);
+  // the pairs going through InsertEntry below are covered by this guard
+  std::shared_lock<std::shared_mutex> bloomGuard;
+  if (bloom_filter_ != nullptr) {
+    bloomGuard = bloom_filter_->GuardInsert();
+    for (const MappingType &item : items)
+      bloom_filter_->Add(item.first);
+  }
+  while (i < items.size()) {
+    Page *page;
+    KeyType upper;
+    bool hasUpper = false;
+    if (blink_) {
+      page = BLinkFindLeafPage(items[i].first,false,true,nullptr);
+      if (page != nullptr) {
+        B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+        hasUpper = leaf->GetNextPageId() != INVALID_PAGE_ID;
+        if (hasUpper)
+          upper = leaf->GetHighKey();
+      }
+    } else {
+      page = ScanFindLeafPage(items[i].first,upper,hasUpper,true);
+    }
+    if (page == nullptr) {
+      // empty tree
+      inserted += InsertEntry(items[i].first,items[i].second,transaction);
+      i++;
+      continue;
+    }
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+    bool dirty = false;
+    bool full = false;
+    for (; i < items.size(); i++) {
+      const KeyType &key = items[i].first;
+      if (hasUpper && comparator_(key,upper) >= 0)
+        break;
+      ValueType v;
+      if (leaf->Lookup(key,v,comparator_)) {
+        bool added;
+        try {
+          added = !unique_ && InsertPosting(leaf,key,v,items[i].second);
+        } catch (...) {
+          page->WUnlatch();
+          buffer_pool_manager_->UnpinPage(page->GetPageId(),dirty);
+          throw;
+        }
+        if (added) {
+          inserted++;
+          dirty = true;
+        }
+        continue;
+      }
+      if (leaf->GetSize() >= leaf->GetMaxSize()) {
+        full = true;
+        break;
+      }
+      leaf->Insert(key,items[i].second,comparator_);
+      inserted++;
+      dirty = true;
+    }
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),dirty);
+    if (full) {
+      inserted += InsertEntry(items[i].first,items[i].second,transaction);
+      i++;
+    }
   }
+  return inserted;
 }
+
 /*
  * Insert constant key & value pair into an empty tree
  * User needs to first ask for new page from buffer pool manager(NOTICE: throw
@@ -95,7 +479,10 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
   UpdateRootPageId(true);
   
   B_PLUS_TREE_LEAF_PAGE_TYPE *r = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(rp->GetData());
-  r->Init(newId,INVALID_PAGE_ID);
+  InitPage(r, newId);
+  r->SetRootPage(true);
+  if (blink_)
+    r->ReserveHighKey();
   r->Insert(key,value,comparator_);
   buffer_pool_manager_->UnpinPage(newId,true);
 }
@@ -105,46 +492,135 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value) {
  * User needs to first find the right leaf page as insertion target, then look
  * through leaf page to see whether insert key exist or not. If exist, return
  * immdiately, otherwise insert entry. Remember to deal with split if necessary.
- * @return: since we only support unique key, if user try to insert duplicate
- * keys return false, otherwise return true.
+ * An existing key of a non-unique tree gets value added to its posting list,
+ * which leaves the leaf size unchanged.
+ * A counted tree counts the new key on its path before any split.
+ * @return: same as Insert()
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
                                     Transaction *transaction) {
   B_PLUS_TREE_LEAF_PAGE_TYPE *lp = FindLeafPage(key,false,OpType::INSERT,transaction);
+  if (lp == nullptr) {
+    // a remove emptied the tree since InsertEntry looked, nothing is held:
+    // start over so that the new tree is started under the exclusive lock
+    return InsertEntry(key,value,transaction);
+  }
   ValueType v;
 
   if (lp->Lookup(key,v,comparator_)) {
+    bool r;
+    try {
+      r = !unique_ && InsertPosting(lp,key,v,value);
+    } catch (...) {
+      FreePagesInTransaction(true,transaction);
+      throw;
+    }
     FreePagesInTransaction(true,transaction);
-    return false;
+    return r;
   }else{
+    bool append = lp->GetNextPageId() == INVALID_PAGE_ID &&
+                  (lp->GetSize() == 0 ||
+                   comparator_(lp->KeyAt(lp->GetSize() - 1), key) < 0);
     lp->Insert(key,value,comparator_);
+    if (counted_)
+      AddToPathCounts(transaction,1);
     if (lp->GetSize() > lp->GetMaxSize()) {
-      B_PLUS_TREE_LEAF_PAGE_TYPE *nlp = Split(lp,transaction);
-      InsertIntoParent(lp,nlp->KeyAt(0),nlp,transaction);
+      B_PLUS_TREE_LEAF_PAGE_TYPE *nlp = Split(lp,transaction,append);
+      // a prefix layout parent stores fewer bytes of a shorter separator
+      KeyType sep = prefix_ ? ShortestSeparator(lp->KeyAt(lp->GetSize() - 1),nlp->KeyAt(0))
+                            : nlp->KeyAt(0);
+      InsertIntoParent(lp,sep,nlp,transaction,append);
+      if (nlp->GetNextPageId() == INVALID_PAGE_ID)
+        rightmost_leaf_ = nlp->GetPageId();
+    } else if (lp->GetNextPageId() == INVALID_PAGE_ID) {
+      rightmost_leaf_ = lp->GetPageId();
     }
     FreePagesInTransaction(true,transaction);
     return true;
   }
 }
 
+/*
+ * Fast path for keys inserted in increasing order: append to the rightmost
+ * leaf remembered by an earlier insert, without descending from the root.
+ * The leaf is validated under its write latch: it must still be remembered
+ * (a page is forgotten while latched, before it is freed), have no right
+ * sibling, have room and a last key below key. A counted tree always
+ * descends, the counts above the leaf have to grow too.
+ * @return: false means caller takes the normal descent
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::AppendToRightmostLeaf(const KeyType &key,
+                                           const ValueType &value) {
+  page_id_t pid = rightmost_leaf_;
+  if (pid == INVALID_PAGE_ID || counted_)
+    return false;
+  Page *page = buffer_pool_manager_->FetchPage(pid);
+  if (page == nullptr)
+    return false;
+  page->WLatch();
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  bool append = rightmost_leaf_ == pid &&
+                leaf->GetNextPageId() == INVALID_PAGE_ID &&
+                leaf->GetSize() > 0 && leaf->GetSize() < leaf->GetMaxSize() &&
+                comparator_(leaf->KeyAt(leaf->GetSize() - 1), key) < 0;
+  if (append)
+    leaf->Insert(key,value,comparator_);
+  page->WUnlatch();
+  ReleasePage(pid,append);
+  return append;
+}
+
+/*
+ * Entries an overflowing page on the rightmost path keeps when split by an
+ * append, -1 for an even split
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int BPLUSTREE_TYPE::AppendSplitSize(const BPlusTreePage *node) const {
+  if (appendSplitFill <= 0.5)
+    return -1;
+  // the new page needs an entry, an internal page also one past its key
+  int total = node->GetMaxSize() + 1;
+  int keep = std::min(static_cast<int>(total * appendSplitFill),
+                      total - (node->IsLeafPage() ? 1 : 2));
+  return std::max(keep, total / 2);
+}
+
+/*
+ * Called with the write latch of a page about to be freed, drops the
+ * shortcuts that may lead to it
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ForgetPage(page_id_t page_id) {
+  rightmost_leaf_.compare_exchange_strong(page_id,INVALID_PAGE_ID);
+  if (adaptive_hash_ != nullptr)
+    adaptive_hash_->NewEpoch();
+}
+
 /*
  * Split input page and return newly created page.
  * Using template N to represent either internal page or leaf page.
  * User needs to first ask for new page from buffer pool manager(NOTICE: throw
  * an "out of memory" exception if returned value is nullptr), then move half
  * of key & value pairs from input page to newly created page
+ * @param   append    node is on the rightmost path and the new entry is past
+ * its last one: node keeps appendSplitFill of the entries
  */
 INDEX_TEMPLATE_ARGUMENTS
-template <typename N> N *BPLUSTREE_TYPE::Split(N *node, Transaction *transaction) {
+template <typename N>
+N *BPLUSTREE_TYPE::Split(N *node, Transaction *transaction, bool append) {
   page_id_t newId;
   Page* const newPage = buffer_pool_manager_->NewPage(newId);
   newPage->WLatch();
   transaction->AddIntoPageSet(newPage);
   
   N *newNode = reinterpret_cast<N *>(newPage->GetData());
-  newNode->Init(newId, node->GetParentPageId());
-  node->MoveHalfTo(newNode, buffer_pool_manager_);
+  InitPage(newNode, newId);
+  node->MoveHalfTo(newNode, buffer_pool_manager_,
+                   append ? AppendSplitSize(node) : -1);
+  if (newNode->IsLeafPage())
+    UpdatePrevPageId(reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(newNode));
   
   return newNode;
 }
@@ -157,38 +633,281 @@ template <typename N> N *BPLUSTREE_TYPE::Split(N *node, Transaction *transaction
  * User needs to first find the parent page of old_node, parent node must be
  * adjusted to take info of new_node into account. Remember to deal with split
  * recursively if necessary.
+ * Parent page is already write latched in transaction page set (see
+ * GetParentPage), since old_node was unsafe during descent.
+ * The key ranges of both nodes are cut at key, which lets prefix layout pages
+ * grow their prefix. A counted parent takes the counts of both nodes, its own
+ * count in the grandparent does not change.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
                                       const KeyType &key,
                                       BPlusTreePage *new_node,
-                                      Transaction *transaction) {
+                                      Transaction *transaction, bool append) {
+  if (prefix_) {
+    KeyType low, high;
+    bool hasLow = false, hasHigh = false;
+    if (!old_node->IsRootPage()) {
+      B_PLUS_TREE_INTERNAL_PAGE *pp = GetParentPage(old_node,transaction);
+      int index = pp->ValueIndex(old_node->GetPageId());
+      if ((hasLow = index > 0))
+        low = pp->KeyAt(index);
+      if ((hasHigh = index + 1 < pp->GetSize()))
+        high = pp->KeyAt(index + 1);
+    }
+    SetKeyRange(old_node,hasLow ? &low : nullptr,&key);
+    SetKeyRange(new_node,&key,hasHigh ? &high : nullptr);
+  }
   if (old_node->IsRootPage()) {
     Page* const np = buffer_pool_manager_->NewPage(root_page_id_);
     B_PLUS_TREE_INTERNAL_PAGE *nr = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(np->GetData());
-    nr->Init(root_page_id_);
+    InitPage(nr, root_page_id_);
+    nr->SetRootPage(true);
     nr->PopulateNewRoot(old_node->GetPageId(),key,new_node->GetPageId());
+    if (counted_) {
+      nr->SetCountAt(0,SubtreeCount(old_node));
+      nr->SetCountAt(1,SubtreeCount(new_node));
+    }
     
-    old_node->SetParentPageId(root_page_id_);
-    new_node->SetParentPageId(root_page_id_);
+    old_node->SetRootPage(false);
     UpdateRootPageId();
     buffer_pool_manager_->UnpinPage(nr->GetPageId(),true);
     return;
   }else{
-    page_id_t pId = old_node->GetParentPageId();
-    new_node->SetParentPageId(pId);
-    
-    auto *p = FetchPage(pId);
-    B_PLUS_TREE_INTERNAL_PAGE *pp = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(p);   
+    B_PLUS_TREE_INTERNAL_PAGE *pp = GetParentPage(old_node,transaction);
     pp->InsertNodeAfter(old_node->GetPageId(), key, new_node->GetPageId());
+    if (counted_) {
+      UpdateCount(pp,old_node);
+      UpdateCount(pp,new_node);
+    }
     if (pp->GetSize() > pp->GetMaxSize()) {
-      B_PLUS_TREE_INTERNAL_PAGE *newLeafPage = Split(pp,transaction);
-      InsertIntoParent(pp,newLeafPage->KeyAt(0),newLeafPage,transaction);
+      B_PLUS_TREE_INTERNAL_PAGE *newLeafPage = Split(pp,transaction,append);
+      InsertIntoParent(pp,newLeafPage->KeyAt(0),newLeafPage,transaction,append);
     }
-    buffer_pool_manager_->UnpinPage(pId,true);
   }
 }
 
+/*****************************************************************************
+ * BULK LOAD
+ *****************************************************************************/
+/*
+ * Build the tree bottom-up instead of one root-to-leaf descent per pair:
+ * leaves are filled left to right, then each internal level is built from the
+ * first keys of the level below until a single root page is left. Pages of a
+ * level are allocated one after another, so a leaf scan reads them in page id
+ * order. Equal keys go into a posting list in a non-unique tree.
+ * Root page id is locked for the whole load, the tree is published at the end.
+ * @param   next      stores the next pair in key order and returns true, or
+ *                    returns false at the end
+ * @throw : the tree is not empty, keys are out of order or (unique tree)
+ * duplicated, or the buffer pool is full; pages loaded so far are freed with
+ * their posting lists
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkLoad(const std::function<bool(MappingType &)> &next,
+                              double fill_factor) {
+  fill_factor = std::min(1.0, std::max(0.5, fill_factor));
+  // BulkLoadLeaves adds the keys to the Bloom filter
+  std::shared_lock<std::shared_mutex> bloomGuard;
+  if (bloom_filter_ != nullptr)
+    bloomGuard = bloom_filter_->GuardInsert();
+  LockRootPageId(true);
+  if (!IsEmpty()) {
+    TryUnlockRootPageId(true);
+    throw Exception(EXCEPTION_TYPE_INDEX, "bulk load into a non-empty tree");
+  }
+  // first key and page id of every page of the level being built
+  std::vector<std::pair<KeyType, page_id_t>> level;
+  bool leaves = true;
+  try {
+    BulkLoadLeaves(next,fill_factor,level);
+    while (level.size() > 1) {
+      BulkLoadInternalLevel(fill_factor,level);
+      leaves = false;
+    }
+    if (!level.empty()) {
+      FetchPage(level[0].second)->SetRootPage(true);
+      buffer_pool_manager_->UnpinPage(level[0].second,true);
+    }
+  } catch (...) {
+    // level is complete, its subtrees hold every page loaded so far. Pages
+    // that can not be read stay allocated, the error of the load is the one
+    // reported.
+    std::vector<Page *> latched;
+    try {
+      for (const auto &node : level)
+        FreeSubtree(node.second,leaves,latched);
+    } catch (...) {
+    }
+    TryUnlockRootPageId(true);
+    throw;
+  }
+  if (!level.empty()) {
+    root_page_id_ = level[0].second;
+    UpdateRootPageId(true);
+  }
+  TryUnlockRootPageId(true);
+}
+
+/*
+ * Fill leaf pages with the pairs of next, linking each to the one before. A
+ * leaf takes fill_factor of its max size (of its space if slotted), the last
+ * leaf is merged into or balanced with its left sibling if it ends up below
+ * min size. On failure level keeps the leaves filled so far, for BulkLoad to
+ * free.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkLoadLeaves(
+    const std::function<bool(MappingType &)> &next, double fill_factor,
+    std::vector<std::pair<KeyType, page_id_t>> &level) {
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = nullptr;
+  // left sibling of a last leaf below min size
+  B_PLUS_TREE_LEAF_PAGE_TYPE *sibling = nullptr;
+  MappingType item;
+  try {
+    while (next(item)) {
+      if (bloom_filter_ != nullptr)
+        bloom_filter_->Add(item.first);
+      if (leaf != nullptr) {
+        MappingType last = leaf->GetItem(leaf->GetSize() - 1);
+        int c = comparator_(item.first,last.first);
+        if (c < 0)
+          throw Exception(EXCEPTION_TYPE_INDEX, "bulk load input is not sorted");
+        if (c == 0) {
+          if (unique_)
+            throw Exception(EXCEPTION_TYPE_INDEX, "bulk load input has duplicate key");
+          InsertPosting(leaf,item.first,last.second,item.second);
+          continue;
+        }
+      }
+      if (leaf == nullptr || leaf->IsFilled(fill_factor)) {
+        page_id_t pid;
+        Page *page = buffer_pool_manager_->NewPage(pid);
+        if (page == nullptr)
+          throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+        B_PLUS_TREE_LEAF_PAGE_TYPE *prev = leaf;
+        leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+        InitPage(leaf, pid);
+        if (blink_)
+          leaf->ReserveHighKey();
+        if (prev != nullptr) {
+          prev->SetNextPageId(pid);
+          leaf->SetPrevPageId(prev->GetPageId());
+          if (blink_)
+            prev->SetHighKey(item.first);
+          // the first leaf also takes keys below its first one
+          prev->SetKeyRange(level.size() > 1 ? &level.back().first : nullptr,&item.first);
+          prev->SampleKeySearch();
+          buffer_pool_manager_->UnpinPage(prev->GetPageId(),true);
+        }
+        level.push_back(std::make_pair(item.first,pid));
+      }
+      leaf->Insert(item.first,item.second,comparator_);
+    }
+    if (leaf == nullptr)
+      return;
+    if (level.size() > 1 && leaf->GetSize() < leaf->GetMinSize())
+      sibling = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(FetchPage(level[level.size() - 2].second));
+  } catch (...) {
+    if (leaf != nullptr) {
+      // BulkLoad looks up its keys to free their posting lists
+      leaf->SampleKeySearch();
+      buffer_pool_manager_->UnpinPage(leaf->GetPageId(),true);
+    }
+    throw;
+  }
+  if (sibling != nullptr) {
+    page_id_t siblingId = sibling->GetPageId();
+    if (sibling->GetSize() + leaf->GetSize() <= sibling->MaxSizeWith(leaf)) {
+      leaf->MoveAllTo(sibling,level.back().first,buffer_pool_manager_);
+      buffer_pool_manager_->UnpinPage(leaf->GetPageId(),false);
+      buffer_pool_manager_->DeletePage(leaf->GetPageId());
+      level.pop_back();
+      leaf = sibling;
+    } else {
+      // a slotted leaf may fill up on fewer entries
+      while (sibling->GetSize() > leaf->GetSize() + 1 && leaf->GetSize() < leaf->GetMaxSize())
+        sibling->MoveLastToFrontOf(leaf,level.back().first,buffer_pool_manager_);
+      level.back().first = leaf->KeyAt(0);
+      if (blink_)
+        sibling->SetHighKey(leaf->KeyAt(0));
+      sibling->SampleKeySearch();
+      buffer_pool_manager_->UnpinPage(siblingId,true);
+    }
+  }
+  leaf->SampleKeySearch();
+  buffer_pool_manager_->UnpinPage(leaf->GetPageId(),true);
+}
+
+/*
+ * Replace level with the internal pages right above it. Its pages are spread
+ * evenly over as few internal pages as fill_factor allows, without leaving
+ * any of them below min size. A counted tree reads the count of every page of
+ * level back from it. On failure the internal pages are freed and level is
+ * left as it was.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkLoadInternalLevel(
+    double fill_factor, std::vector<std::pair<KeyType, page_id_t>> &level) {
+  std::vector<std::pair<KeyType, page_id_t>> upper;
+  B_PLUS_TREE_INTERNAL_PAGE *prev = nullptr;
+  size_t n = level.size();
+  size_t nodes = 0;
+  try {
+    for (size_t i = 0, begin = 0; begin < n; i++) {
+      page_id_t pid;
+      Page *page = buffer_pool_manager_->NewPage(pid);
+      if (page == nullptr)
+        throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+      upper.push_back(std::make_pair(level[begin].first,pid));
+      B_PLUS_TREE_INTERNAL_PAGE *internalPage = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(page->GetData());
+      InitPage(internalPage, pid);
+      if (blink_)
+        internalPage->ReserveHighKey();
+      if (nodes == 0) {
+        size_t min = internalPage->GetMinSize();
+        size_t fill = std::max(min,static_cast<size_t>(internalPage->GetMaxSize() * fill_factor));
+        nodes = (n + fill - 1) / fill;
+        if (nodes > 1 && n / nodes < min)
+          nodes = std::max<size_t>(1,n / min);
+      }
+      size_t end = (i + 1) * n / nodes;
+      internalPage->PopulateNewRoot(level[begin].second,level[begin + 1].first,level[begin + 1].second);
+      // unused by search, kept like a split does: the first key of the subtree
+      internalPage->SetKeyAt(0,level[begin].first);
+      for (size_t j = begin + 2; j < end; j++)
+        internalPage->InsertNodeAfter(level[j - 1].second,level[j].first,level[j].second);
+      if (counted_) {
+        for (size_t j = begin; j < end; j++)
+          internalPage->SetCountAt(j - begin,SubtreeCount(level[j].second));
+      }
+      internalPage->SetKeyRange(begin > 0 ? &level[begin].first : nullptr,
+                                end < n ? &level[end].first : nullptr);
+      internalPage->SampleKeySearch();
+      if (prev != nullptr) {
+        if (blink_) {
+          prev->SetRightPageId(pid);
+          prev->SetHighKey(level[begin].first);
+        }
+        buffer_pool_manager_->UnpinPage(prev->GetPageId(),true);
+      }
+      prev = internalPage;
+      begin = end;
+    }
+  } catch (...) {
+    // the page being built and the one before it are still pinned
+    for (const auto &node : upper) {
+      if (node.second == upper.back().second ||
+          (prev != nullptr && node.second == prev->GetPageId()))
+        buffer_pool_manager_->UnpinPage(node.second,false);
+      FreePage(node.second);
+    }
+    throw;
+  }
+  buffer_pool_manager_->UnpinPage(prev->GetPageId(),true);
+  level.swap(upper);
+}
+
 /*****************************************************************************
  * REMOVE
  *****************************************************************************/
@@ -201,12 +920,55 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
+  RemoveEntry(key,nullptr,transaction);
+}
+
+/*
+ * Delete the key & value pair only, a key with other values in its posting
+ * list stays in leaf page. Nothing happens if the pair does not exist.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::Remove(const KeyType &key, const ValueType &value,
+                            Transaction *transaction) {
+  RemoveEntry(key,&value,transaction);
+}
+
+/*
+ * @param   value      if not null, only this value of key is deleted
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::RemoveEntry(const KeyType &key, const ValueType *value,
+                                 Transaction *transaction) {
   if (IsEmpty()) return;
+  if (bloom_filter_ != nullptr && !bloom_filter_->MayContain(key))
+    return;
+  if (blink_) {
+    BLinkRemove(key,value);
+    return;
+  }
   B_PLUS_TREE_LEAF_PAGE_TYPE *dt = FindLeafPage(key,false,OpType::DELETE,transaction);
-  int curSize = dt->RemoveAndDeleteRecord(key,comparator_);
-  if (curSize < dt->GetMinSize()) {
-    //LOG_DEBUG("2");
-    CoalesceOrRedistribute(dt,transaction);
+  if (dt == nullptr) return;
+  bool remove;
+  try {
+    remove = RemovePosting(dt,key,value);
+  } catch (...) {
+    FreePagesInTransaction(true,transaction);
+    throw;
+  }
+  if (remove) {
+    int oldSize = dt->GetSize();
+    int curSize = dt->RemoveAndDeleteRecord(key,comparator_);
+    if (counted_ && curSize < oldSize)
+      AddToPathCounts(transaction,-1);
+    if (bloom_filter_ != nullptr && curSize < oldSize)
+      bloom_filter_->CountRemove();
+    if (curSize < MergeSize(dt)) {
+      //LOG_DEBUG("2");
+      CoalesceOrRedistribute(dt,transaction);
+    } else if (lazyRebalance && curSize == dt->GetMinSize() - 1) {
+      std::lock_guard<std::mutex> guard(deferred_mutex_);
+      deferred_keys_.push_back(key);
+    }
   }
   FreePagesInTransaction(true,transaction);
   //assert(Check());
@@ -234,19 +996,16 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction) {
   }
   
   //LOG_DEBUG("3");  
-  BPlusTreePage *p = FetchPage(node->GetParentPageId());
-  B_PLUS_TREE_INTERNAL_PAGE *pp = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(p);
+  B_PLUS_TREE_INTERNAL_PAGE *pp = GetParentPage(node,transaction);
   bool isRightSib = FindLeftSibling(node,node2,transaction);
   
-  if (node->GetSize() + node2->GetSize() <= node->GetMaxSize()) {
+  if (node->GetSize() + node2->GetSize() <= node->MaxSizeWith(node2)) {
     if (isRightSib) 
       swap(node,node2);
     Coalesce(node2,node,pp,pp->ValueIndex(node->GetPageId()),transaction);
-    buffer_pool_manager_->UnpinPage(pp->GetPageId(), true);
     return true;
   }else{
-    Redistribute(node2,node,pp->ValueIndex(node->GetPageId()));
-    buffer_pool_manager_->UnpinPage(pp->GetPageId(), false);
+    Redistribute(node2,node,pp,pp->ValueIndex(node->GetPageId()));
     return false;
   }
 
@@ -256,8 +1015,7 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction) {
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
 bool BPLUSTREE_TYPE::FindLeftSibling(N *node, N * &sibling, Transaction *transaction) {
-  auto page = FetchPage(node->GetParentPageId());
-  B_PLUS_TREE_INTERNAL_PAGE *p = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(page);
+  B_PLUS_TREE_INTERNAL_PAGE *p = GetParentPage(node,transaction);
   int index = p->ValueIndex(node->GetPageId());
   //LOG_DEBUG("%d",index);
   int sidx;
@@ -268,7 +1026,6 @@ bool BPLUSTREE_TYPE::FindLeftSibling(N *node, N * &sibling, Transaction *transac
   }
   sibling = reinterpret_cast<N *>(CrabingProtocalFetchPage(
           p->ValueAt(sidx),OpType::DELETE,-1,transaction));
-  buffer_pool_manager_->UnpinPage(p->GetPageId(), false);
   return index == 0;
 }
 
@@ -291,10 +1048,15 @@ bool BPLUSTREE_TYPE::Coalesce(
         N *&neighbor_node, N *&node,
         BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *&parent,
         int index, Transaction *transaction) {
-  node->MoveAllTo(neighbor_node,index,buffer_pool_manager_);
+  node->MoveAllTo(neighbor_node,parent->KeyAt(index),buffer_pool_manager_);
+  if (neighbor_node->IsLeafPage())
+    UpdatePrevPageId(reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(neighbor_node));
+  if (counted_)
+    UpdateCount(parent,neighbor_node);
+  ForgetPage(node->GetPageId());
   transaction->AddIntoDeletedPageSet(node->GetPageId());
   parent->Remove(index);
-  if (parent->GetSize() <= parent->GetMinSize()) {
+  if (parent->GetSize() <= MergeSize(parent)) {
     return CoalesceOrRedistribute(parent,transaction);
   }else{
     return false;
@@ -306,18 +1068,30 @@ bool BPLUSTREE_TYPE::Coalesce(
  * Redistribute key & value pairs from one page to its sibling page. If index ==
  * 0, move sibling page's first key & value pair into end of input "node",
  * otherwise move sibling page's last key & value pair into head of input
- * "node".
+ * "node". Then update the separator of the two pages in parent page (and
+ * their counts in a counted tree).
  * Using template N to represent either internal page or leaf page.
  * @param   neighbor_node      sibling page of input "node"
  * @param   node               input from method coalesceOrRedistribute()
+ * @param   parent             parent page of both
+ * @param   index              index of input "node" in parent page
  */
 INDEX_TEMPLATE_ARGUMENTS
 template <typename N>
-void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index) {
+void BPLUSTREE_TYPE::Redistribute(
+        N *neighbor_node, N *node,
+        BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *parent,
+        int index) {
   if (index == 0) {
-    neighbor_node->MoveFirstToEndOf(node,buffer_pool_manager_);
+    neighbor_node->MoveFirstToEndOf(node,parent->KeyAt(1),buffer_pool_manager_);
+    parent->SetKeyAt(1,neighbor_node->KeyAt(0));
   } else {
-    neighbor_node->MoveLastToFrontOf(node, index, buffer_pool_manager_);
+    neighbor_node->MoveLastToFrontOf(node,parent->KeyAt(index),buffer_pool_manager_);
+    parent->SetKeyAt(index,node->KeyAt(0));
+  }
+  if (counted_) {
+    UpdateCount(parent,node);
+    UpdateCount(parent,neighbor_node);
   }
 }
 /*
@@ -333,104 +1107,1845 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index) {
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
   if (old_root_node->IsLeafPage()) {
+    ForgetPage(old_root_node->GetPageId());
     root_page_id_ = INVALID_PAGE_ID;
     UpdateRootPageId();
     return true;
   }
   else if (old_root_node->GetSize() == 1) {
     B_PLUS_TREE_INTERNAL_PAGE *root = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(old_root_node);
+    // the child is fetched before the root gives it up
+    Page *page = buffer_pool_manager_->FetchPage(root->ValueAt(0));
+    if (page == nullptr) {
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
     const page_id_t newId = root->RemoveAndReturnOnlyChild();
     root_page_id_ = newId;
     UpdateRootPageId();
-    Page *page = buffer_pool_manager_->FetchPage(newId);
-    B_PLUS_TREE_INTERNAL_PAGE *nr =
-            reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(page->GetData());
-    nr->SetParentPageId(INVALID_PAGE_ID);
+    BPlusTreePage *nr = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    nr->SetRootPage(true);
     buffer_pool_manager_->UnpinPage(newId, true);
     return true;
   }else
     return false;
 }
 
-/*****************************************************************************
- * INDEX ITERATOR
- *****************************************************************************/
 /*
- * Input parameter is void, find the leaftmost leaf page first, then construct
- * index iterator
- * @return : index iterator
+ * Size a non-root page is merged or refilled below (a leaf once under it, an
+ * internal page once at it, as for GetMinSize), scaled by mergeThreshold.
+ * Never above min size, which a prefix layout page keeps while its max size
+ * grows.
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin() {
-  KeyType a;
-  B_PLUS_TREE_LEAF_PAGE_TYPE* sleaf = FindLeafPage(a, true);
-  TryUnlockRootPageId(false);
-  return INDEXITERATOR_TYPE(sleaf, 0, buffer_pool_manager_);
+int BPLUSTREE_TYPE::MergeSize(const BPlusTreePage *node) const {
+  if (node->IsRootPage() || mergeThreshold >= 0.5)
+    return node->GetMinSize();
+  return std::min(node->GetMinSize(),
+                  std::max(1, static_cast<int>(node->GetMaxSize() * mergeThreshold)));
 }
 
 /*
- * Input parameter is low key, find the leaf page that contains the input key
- * first, then construct index iterator
- * @return : index iterator
+ * Point the prev page id of the leaf after input leaf back at it, after a
+ * split or merge has made it the next page id of leaf. The next leaf is write
+ * latched while leaf is latched: leaf latches are only ever waited for left
+ * to right, readers never hold one leaf while waiting for another (see
+ * ReverseIndexIterator).
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) {
-  B_PLUS_TREE_LEAF_PAGE_TYPE* sleaf = FindLeafPage(key);
-  TryUnlockRootPageId(false);
-  if (sleaf == nullptr) {
-    return INDEXITERATOR_TYPE(sleaf, 0, buffer_pool_manager_);
-  }else{
-    int index = sleaf->KeyIndex(key,comparator_);
-    return INDEXITERATOR_TYPE(sleaf, index, buffer_pool_manager_);
+void BPLUSTREE_TYPE::UpdatePrevPageId(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf) {
+  page_id_t next = leaf->GetNextPageId();
+  if (next == INVALID_PAGE_ID)
+    return;
+  Page *page = buffer_pool_manager_->FetchPage(next);
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
   }
+  page->WLatch();
+  reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData())->SetPrevPageId(leaf->GetPageId());
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(next,true);
 }
 
 /*****************************************************************************
- * UTILITIES AND DEBUG
+ * RANGE DELETE
  *****************************************************************************/
 /*
- * Find leaf page containing particular key, if leftMost flag == true, find
- * the left most leaf page
+ * Remove every key in [lo, hi] together with its value(s). Root page id is
+ * locked in exclusive mode for the whole operation, so no new operation
+ * enters the tree while pages are underfull.
+ * Children between the child of lo and the child of hi are unlinked from
+ * their parent and freed as whole subtrees, the two boundary children are
+ * trimmed recursively (see DeleteRangeInPage). Nothing is unlinked before the
+ * descent has linked the leaf of lo to the leaf of hi, nor freed before it is
+ * unlinked, so a descent that runs out of pages leaves part of the range
+ * removed in a consistent tree. Underfull pages can then only
+ * lie on the paths to lo and hi, which are fixed from the top down until
+ * both are clean (see RebalancePath). A prefix layout tree also fixes the
+ * paths to the pages emptied in place of freed subtrees. A counted tree
+ * recounts the trimmed children on the way back up.
  */
 INDEX_TEMPLATE_ARGUMENTS
-B_PLUS_TREE_LEAF_PAGE_TYPE *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key,
-                                                         bool leftMost,OpType op,
-                                                         Transaction *transaction) {
-  bool jug = (op != OpType::SEARCH);
-  LockRootPageId(jug);
+void BPLUSTREE_TYPE::DeleteRange(const KeyType &lo, const KeyType &hi) {
+  if (comparator_(lo, hi) > 0) return;
+  // keys freed with their pages are not counted one by one
+  if (bloom_filter_ != nullptr)
+    bloom_filter_->MarkStale();
+  if (blink_) {
+    BLinkDeleteRange(lo,hi);
+    return;
+  }
+  LockRootPageId(true);
   if (IsEmpty()) {
-    TryUnlockRootPageId(jug);
-    return nullptr;
+    TryUnlockRootPageId(true);
+    return;
   }
-  BPlusTreePage* p = CrabingProtocalFetchPage(root_page_id_,op,-1,transaction);
-  page_id_t next;
-  for (page_id_t cur = root_page_id_; !p->IsLeafPage(); p =
-          CrabingProtocalFetchPage(next,op,cur,transaction),cur = next) {
-    B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(p);
-    if (leftMost) {
-      next = internalPage->ValueAt(0);
-    }else {
-      next = internalPage->Lookup(key,comparator_);
+  // freed subtrees are not latched, nor read for a unique tree: positions
+  // stored before the range is unlinked are dropped now, the ones stored
+  // while it is still reachable once it is gone
+  if (adaptive_hash_ != nullptr)
+    adaptive_hash_->NewEpoch();
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (page == nullptr) {
+    TryUnlockRootPageId(true);
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  page->WLatch();
+  Page *left_leaf = nullptr;
+  std::vector<KeyType> keys{lo,hi};
+  // pages the descent holds write latched, released in one go if it fails
+  std::vector<Page *> latched{page};
+  std::vector<RangeUnlink> unlinks;
+  try {
+    DeleteRangeInPage(page,lo,hi,true,true,left_leaf,latched,unlinks,nullptr,nullptr,&keys);
+    // subtrees to free, and whether they are leaves
+    std::vector<std::pair<page_id_t, bool>> subtrees;
+    for (RangeUnlink &unlink : unlinks) {
+      B_PLUS_TREE_INTERNAL_PAGE *internalPage = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(unlink.page->GetData());
+      for (int i = unlink.from; i < unlink.to; i++)
+        subtrees.emplace_back(internalPage->ValueAt(i),unlink.leaf);
+      internalPage->RemoveRange(unlink.from,unlink.to);
+      if (unlink.emptied) {
+        if (counted_)
+          internalPage->SetCountAt(0,0);
+        internalPage->SetKeyRange(&unlink.low,&unlink.high);
+      }
+      UnlatchPage(unlink.page,latched,true);
+    }
+    if (adaptive_hash_ != nullptr)
+      adaptive_hash_->NewEpoch();
+    for (const auto &subtree : subtrees)
+      FreeSubtree(subtree.first,subtree.second,latched);
+    for (bool fixed = true; fixed;) {
+      fixed = false;
+      for (const KeyType &key : keys)
+        fixed = RebalancePath(key) || fixed;
     }
+  } catch (...) {
+    for (Page *p : latched) {
+      p->WUnlatch();
+      buffer_pool_manager_->UnpinPage(p->GetPageId(),true);
+    }
+    TryUnlockRootPageId(true);
+    throw;
   }
-  return static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(p);
+  FreePendingPages();
+  TryUnlockRootPageId(true);
 }
 
-
-INDEX_TEMPLATE_ARGUMENTS
-BPlusTreePage *BPLUSTREE_TYPE::FetchPage(page_id_t page_id) {
-  Page* page = buffer_pool_manager_->FetchPage(page_id);
-  return reinterpret_cast<BPlusTreePage *>(page->GetData());
-}
+/*
+ * Remove keys of [lo, hi] below the write latched page, then release it.
+ * has_lo (has_hi) tells whether lo (hi) falls inside the range of page, a
+ * bound outside of it covers that whole side of page.
+ * The leaf of lo stays latched in left_leaf until the leaf of hi is reached,
+ * then the two are linked to each other over the leaves in between. Leaf
+ * latches are taken left to right, as in UpdatePrevPageId.
+ * The block of children in between is left in place: page stays latched and
+ * the block is added to unlinks, for DeleteRange to unlink once the leaves
+ * are linked.
+ * In a prefix layout tree the neighbours of a removed block of children can
+ * not take over its key range, which their prefix may not cover: the first
+ * child of the block is emptied and kept instead (see EmptySubtree), and the
+ * low key of the block is added to emptied.
+ * Every page latched below is kept in latched while it is held, so that
+ * DeleteRange can release them all if the descent throws.
+ * @param   low, high  key range of page, null if not known (then no block is
+ *                     removed on that side of page)
+ * @return : number of keys left below page in a counted tree
+ */
 INDEX_TEMPLATE_ARGUMENTS
-BPlusTreePage *BPLUSTREE_TYPE::CrabingProtocalFetchPage(page_id_t page_id,OpType op,page_id_t previous, Transaction *transaction) {
-  bool jug = (op != OpType::SEARCH);
-  Page* page = buffer_pool_manager_->FetchPage(page_id);
-  Lock(jug,page);
-  BPlusTreePage* treePage = reinterpret_cast<BPlusTreePage *>(page->GetData());
-  if (previous > 0 && (!jug || treePage->IsSafe(op))) 
-    FreePagesInTransaction(jug,transaction,previous);
-  if (transaction != nullptr)
+size_t BPLUSTREE_TYPE::DeleteRangeInPage(Page *page, const KeyType &lo,
+                                         const KeyType &hi, bool has_lo,
+                                         bool has_hi, Page *&left_leaf,
+                                         std::vector<Page *> &latched,
+                                         std::vector<RangeUnlink> &unlinks,
+                                         const KeyType *low, const KeyType *high,
+                                         std::vector<KeyType> *emptied) {
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (node->IsLeafPage()) {
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+    size_t count = RemoveRangeFromLeaf(leaf,lo,hi,has_lo,has_hi);
+    if (has_lo && !has_hi) {
+      left_leaf = page;
+      return count;
+    }
+    if (!has_lo && has_hi) {
+      reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(left_leaf->GetData())->SetNextPageId(page->GetPageId());
+      leaf->SetPrevPageId(left_leaf->GetPageId());
+      UnlatchPage(left_leaf,latched,true);
+      left_leaf = nullptr;
+    }
+    UnlatchPage(page,latched,true);
+    return count;
+  }
+  B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+  int size = internalPage->GetSize();
+  int first = has_lo ? internalPage->ValueIndex(internalPage->Lookup(lo,comparator_)) : -1;
+  int last = has_hi ? internalPage->ValueIndex(internalPage->Lookup(hi,comparator_)) : size;
+  KeyType childLow, childHigh;
+  // recurse into the child at index i with its key range
+  auto descend = [&](int i, bool child_lo, bool child_hi) {
+    const KeyType *l = low, *h = high;
+    if (i > 0)
+      l = &(childLow = internalPage->KeyAt(i));
+    if (i + 1 < internalPage->GetSize())
+      h = &(childHigh = internalPage->KeyAt(i + 1));
+    Page *child = buffer_pool_manager_->FetchPage(internalPage->ValueAt(i));
+    if (child == nullptr) {
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    child->WLatch();
+    latched.push_back(child);
+    size_t count = DeleteRangeInPage(child,lo,hi,child_lo,child_hi,left_leaf,latched,unlinks,l,h,emptied);
+    if (counted_)
+      internalPage->SetCountAt(i,count);
+  };
+  // block of children to unlink
+  int next = last;
+  if (first == last) {
+    descend(first,has_lo,has_hi);
+  } else {
+    if (first >= 0) {
+      descend(first,true,false);
+    }
+    next = first + 1;
+    if (last - first > 1) {
+      // page type is read before latching, see OptimisticFindLeafPage
+      bool leaf = FetchPage(internalPage->ValueAt(first + 1))->IsLeafPage();
+      buffer_pool_manager_->UnpinPage(internalPage->ValueAt(first + 1),false);
+      if (prefix_) {
+        assert((first >= 0 || low != nullptr) && (last < size || high != nullptr));
+        KeyType from = first >= 0 ? internalPage->KeyAt(first + 1) : *low;
+        KeyType to = last < size ? internalPage->KeyAt(last) : *high;
+        EmptySubtree(internalPage->ValueAt(first + 1),from,to,left_leaf,latched,unlinks);
+        if (counted_)
+          internalPage->SetCountAt(first + 1,0);
+        emptied->push_back(from);
+        next++;
+      }
+      if (next < last)
+        unlinks.push_back({page,next,last,leaf,false});
+    }
+    if (last < size) {
+      descend(last,false,true);
+    }
+  }
+  size_t count = 0;
+  if (counted_) {
+    for (int i = 0; i < size; i++) {
+      if (i < next || i >= last)
+        count += internalPage->CountAt(i);
+    }
+  }
+  if (next >= last)
+    UnlatchPage(page,latched,true);
+  return count;
+}
+
+/*
+ * Empty the subtree of the first child of a block removed by
+ * DeleteRangeInPage, keeping its leftmost path: every page of the path takes
+ * the key range [low, high) of the whole block and loses all other entries,
+ * the leaf is linked in after left_leaf and replaces it there. RebalancePath
+ * later merges the pages away. The internal pages of the path stay latched
+ * and lose their entries in DeleteRange, see unlinks of DeleteRangeInPage.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::EmptySubtree(page_id_t page_id, const KeyType &low,
+                                  const KeyType &high, Page *&left_leaf,
+                                  std::vector<Page *> &latched,
+                                  std::vector<RangeUnlink> &unlinks) {
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  page->WLatch();
+  latched.push_back(page);
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (node->IsLeafPage()) {
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+    RemoveRangeFromLeaf(leaf,low,high,false,false);
+    leaf->SetKeyRange(&low,&high);
+    reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(left_leaf->GetData())->SetNextPageId(page_id);
+    leaf->SetPrevPageId(left_leaf->GetPageId());
+    UnlatchPage(left_leaf,latched,true);
+    left_leaf = page;
+    return;
+  }
+  B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+  EmptySubtree(internalPage->ValueAt(0),low,high,left_leaf,latched,unlinks);
+  // the leaf of the path is left_leaf now
+  bool leaf = left_leaf->GetPageId() == internalPage->ValueAt(0);
+  unlinks.push_back({page,1,internalPage->GetSize(),leaf,true,low,high});
+}
+
+/*
+ * Set the key range of a prefix layout page, see
+ * BPlusTreeLeafPage::SetKeyRange
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SetKeyRange(BPlusTreePage *node, const KeyType *low,
+                                 const KeyType *high) {
+  if (node->IsLeafPage())
+    static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node)->SetKeyRange(low,high);
+  else
+    static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node)->SetKeyRange(low,high);
+}
+
+/*
+ * Remove keys of [lo, hi] from a write latched leaf, with their posting
+ * lists. A bound with has_lo (has_hi) false is taken as the leaf boundary.
+ * Keys whose posting lists are freed leave the leaf even if a later one can
+ * not be read.
+ * @return   page size after deletion
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int BPLUSTREE_TYPE::RemoveRangeFromLeaf(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf,
+                                        const KeyType &lo, const KeyType &hi,
+                                        bool has_lo, bool has_hi) {
+  int from = has_lo ? leaf->KeyIndex(lo,comparator_) : 0;
+  int to = leaf->GetSize();
+  if (has_hi) {
+    to = leaf->KeyIndex(hi,comparator_);
+    if (to < leaf->GetSize() && comparator_(leaf->KeyAt(to), hi) == 0)
+      to++;
+  }
+  if (from >= to)
+    return leaf->GetSize();
+  if (!unique_) {
+    for (int i = from; i < to; i++) {
+      try {
+        RemovePosting(leaf,leaf->KeyAt(i),nullptr);
+      } catch (...) {
+        leaf->RemoveRange(from,i);
+        throw;
+      }
+    }
+  }
+  return leaf->RemoveRange(from,to);
+}
+
+/*
+ * Free the pages of a subtree that has been unlinked from its parent. Leaves
+ * of a unique tree are deleted without being read. A page still pinned by an
+ * operation that reached it before the unlink is write latched first, so it
+ * is only freed once that operation has left it.
+ * @param   leaf      whether page_id is a leaf page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::FreeSubtree(page_id_t page_id, bool leaf,
+                                 std::vector<Page *> &latched) {
+  if (leaf && unique_ && buffer_pool_manager_->DeletePage(page_id))
+    return;
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  page->WLatch();
+  latched.push_back(page);
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (node->IsLeafPage()) {
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leafPage = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+    if (!unique_) {
+      for (int i = 0; i < leafPage->GetSize(); i++) {
+        RemovePosting(leafPage,leafPage->KeyAt(i),nullptr);
+      }
+    }
+  } else {
+    B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+    bool leafChildren = FetchPage(internalPage->ValueAt(0))->IsLeafPage();
+    buffer_pool_manager_->UnpinPage(internalPage->ValueAt(0),false);
+    for (int i = 0; i < internalPage->GetSize(); i++) {
+      FreeSubtree(internalPage->ValueAt(i),leafChildren,latched);
+    }
+  }
+  UnlatchPage(page,latched,false);
+  FreePage(page_id);
+}
+
+/*
+ * Release a write latched page of latched, see DeleteRange
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::UnlatchPage(Page *page, std::vector<Page *> &latched,
+                                 bool is_dirty) {
+  latched.erase(std::find(latched.begin(),latched.end(),page));
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(),is_dirty);
+}
+
+/*
+ * Write latch the path from root to the leaf of key and fix its topmost
+ * underfull page: a leaf root without keys empties the tree, an internal
+ * root with one child is replaced by the child, any other page merges with
+ * or borrows from a sibling. The parent of a topmost underfull page is at
+ * least half full, so it always has a sibling to offer.
+ * Caller holds root page id in exclusive mode.
+ * @return : false means every page on the path is at least half full
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::RebalancePath(const KeyType &key) {
+  if (IsEmpty()) return false;
+  std::vector<Page *> latched;
+  std::vector<page_id_t> deleted;
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  page->WLatch();
+  latched.push_back(page);
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  bool fixed = false;
+  try {
+    if (node->GetSize() < (node->IsLeafPage() ? 1 : 2)) {
+      AdjustRoot(node);
+      deleted.push_back(node->GetPageId());
+      fixed = true;
+    }
+    while (!fixed && !node->IsLeafPage()) {
+      B_PLUS_TREE_INTERNAL_PAGE *parent = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+      int index = parent->ValueIndex(parent->Lookup(key,comparator_));
+      page = buffer_pool_manager_->FetchPage(parent->ValueAt(index));
+      if (page == nullptr) {
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      }
+      page->WLatch();
+      latched.push_back(page);
+      node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+      if (node->GetSize() >= node->GetMinSize())
+        continue;
+      if (node->IsLeafPage()) {
+        RefillPage(parent,index,static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node),latched,deleted);
+      } else {
+        RefillPage(parent,index,static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node),latched,deleted);
+      }
+      fixed = true;
+    }
+  } catch (...) {
+    // pages are only changed once every page involved is latched
+    for (Page *p : latched) {
+      p->WUnlatch();
+      buffer_pool_manager_->UnpinPage(p->GetPageId(),false);
+    }
+    throw;
+  }
+  for (Page *p : latched) {
+    p->WUnlatch();
+    buffer_pool_manager_->UnpinPage(p->GetPageId(),fixed);
+  }
+  for (page_id_t pid : deleted) {
+    FreePage(pid);
+  }
+  FreePendingPages();
+  return fixed;
+}
+
+/*
+ * Fix the paths to the keys queued by Remove in lazyRebalance mode, one key
+ * at a time under the exclusive root page id lock
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::RebalanceDeferred() {
+  std::vector<KeyType> keys;
+  {
+    std::lock_guard<std::mutex> guard(deferred_mutex_);
+    keys.swap(deferred_keys_);
+  }
+  size_t fixed = 0;
+  for (const KeyType &key : keys) {
+    LockRootPageId(true);
+    try {
+      while (RebalancePath(key)) {
+        fixed++;
+      }
+    } catch (...) {
+      TryUnlockRootPageId(true);
+      throw;
+    }
+    TryUnlockRootPageId(true);
+  }
+  return fixed;
+}
+
+/*
+ * Bring the underfull child at index of parent up to min size: merge it with
+ * its sibling (the left one unless it is the first child) if both fit in one
+ * page, otherwise move entries over one at a time with Redistribute. The
+ * sibling is latched and added to latched, a page emptied by the merge is
+ * added to deleted.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+void BPLUSTREE_TYPE::RefillPage(B_PLUS_TREE_INTERNAL_PAGE *parent, int index,
+                                N *node, std::vector<Page *> &latched,
+                                std::vector<page_id_t> &deleted) {
+  int sidx = index == 0 ? 1 : index - 1;
+  Page *page = buffer_pool_manager_->FetchPage(parent->ValueAt(sidx));
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  page->WLatch();
+  latched.push_back(page);
+  N *sibling = reinterpret_cast<N *>(page->GetData());
+  if (node->GetSize() + sibling->GetSize() > node->MaxSizeWith(sibling)) {
+    while (node->GetSize() < node->GetMinSize()) {
+      Redistribute(sibling,node,parent,index);
+    }
+    return;
+  }
+  N *left = index == 0 ? node : sibling;
+  N *right = index == 0 ? sibling : node;
+  int ridx = index == 0 ? 1 : index;
+  // pin the leaf after right up front, so that UpdatePrevPageId finds it in
+  // the buffer pool once the pages are merged
+  page_id_t next = INVALID_PAGE_ID;
+  if (right->IsLeafPage())
+    next = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(right)->GetNextPageId();
+  if (next != INVALID_PAGE_ID && buffer_pool_manager_->FetchPage(next) == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  right->MoveAllTo(left,parent->KeyAt(ridx),buffer_pool_manager_);
+  if (left->IsLeafPage())
+    UpdatePrevPageId(reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(left));
+  if (next != INVALID_PAGE_ID)
+    buffer_pool_manager_->UnpinPage(next,false);
+  if (counted_)
+    UpdateCount(parent,left);
+  parent->Remove(ridx);
+  ForgetPage(right->GetPageId());
+  deleted.push_back(right->GetPageId());
+}
+
+/*****************************************************************************
+ * SUBTREE COUNTS
+ *****************************************************************************/
+/*
+ * Number of keys in [lo, hi] of a counted tree: keys up to hi minus keys
+ * below lo. Root page id is held in shared mode over both descents, writers
+ * of a counted tree hold it exclusively, so both see the same tree.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::CountRange(const KeyType &lo, const KeyType &hi) {
+  if (!counted_)
+    throw Exception(EXCEPTION_TYPE_INDEX, "tree does not keep subtree counts");
+  if (comparator_(lo, hi) > 0) return 0;
+  LockRootPageId(false);
+  size_t count = 0;
+  try {
+    if (!IsEmpty())
+      count = RankInTree(hi,true) - RankInTree(lo,false);
+  } catch (...) {
+    TryUnlockRootPageId(false);
+    throw;
+  }
+  TryUnlockRootPageId(false);
+  return count;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::Rank(const KeyType &key) {
+  if (!counted_)
+    throw Exception(EXCEPTION_TYPE_INDEX, "tree does not keep subtree counts");
+  LockRootPageId(false);
+  size_t rank;
+  try {
+    rank = IsEmpty() ? 0 : RankInTree(key,false);
+  } catch (...) {
+    TryUnlockRootPageId(false);
+    throw;
+  }
+  TryUnlockRootPageId(false);
+  return rank;
+}
+
+/*
+ * Descend with read crabbing to the leaf of key, adding up the counts of the
+ * children left of the path, then the keys of the leaf below key (up to key
+ * if inclusive). Caller holds root page id of a non-empty tree.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::RankInTree(const KeyType &key, bool inclusive) {
+  size_t rank = 0;
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  page->RLatch();
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  while (!node->IsLeafPage()) {
+    B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+    int index = internalPage->ValueIndex(internalPage->Lookup(key,comparator_));
+    for (int i = 0; i < index; i++)
+      rank += internalPage->CountAt(i);
+    Page *child = buffer_pool_manager_->FetchPage(internalPage->ValueAt(index));
+    if (child == nullptr) {
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    child->RLatch();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    page = child;
+    node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  }
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+  int index = leaf->KeyIndex(key,comparator_);
+  if (inclusive && index < leaf->GetSize() && comparator_(leaf->KeyAt(index),key) == 0)
+    index++;
+  rank += index;
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+  return rank;
+}
+
+/*
+ * Descend to the child whose counts cover rank, taking the counts of the
+ * children passed on the way off rank
+ * @return : false means the tree has rank keys or fewer
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::SelectByRank(size_t rank, KeyType &key) {
+  if (!counted_)
+    throw Exception(EXCEPTION_TYPE_INDEX, "tree does not keep subtree counts");
+  LockRootPageId(false);
+  if (IsEmpty()) {
+    TryUnlockRootPageId(false);
+    return false;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (page == nullptr) {
+    TryUnlockRootPageId(false);
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  page->RLatch();
+  TryUnlockRootPageId(false);
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  bool found = true;
+  while (found && !node->IsLeafPage()) {
+    B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+    int index = 0;
+    while (index < internalPage->GetSize() && rank >= internalPage->CountAt(index))
+      rank -= internalPage->CountAt(index++);
+    if (!(found = index < internalPage->GetSize()))
+      break;
+    Page *child = buffer_pool_manager_->FetchPage(internalPage->ValueAt(index));
+    if (child == nullptr) {
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    child->RLatch();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    page = child;
+    node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  }
+  if (found && node->IsLeafPage()) {
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+    if ((found = rank < static_cast<size_t>(leaf->GetSize())))
+      key = leaf->KeyAt(rank);
+  }
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+  return found;
+}
+
+/*
+ * Number of leaf entries below a page: the size of a leaf, the sum of the
+ * counts of an internal page. Caller keeps writers off the page, it is read
+ * without a latch (it may be write latched by the caller).
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::SubtreeCount(const BPlusTreePage *node) const {
+  if (node->IsLeafPage())
+    return node->GetSize();
+  const B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<const B_PLUS_TREE_INTERNAL_PAGE *>(node);
+  size_t count = 0;
+  for (int i = 0; i < internalPage->GetSize(); i++)
+    count += internalPage->CountAt(i);
+  return count;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::SubtreeCount(page_id_t page_id) {
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  size_t count = SubtreeCount(reinterpret_cast<BPlusTreePage *>(page->GetData()));
+  buffer_pool_manager_->UnpinPage(page_id,false);
+  return count;
+}
+
+/*
+ * Recount child in its write latched parent after entries moved in or out
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::UpdateCount(B_PLUS_TREE_INTERNAL_PAGE *parent,
+                                 const BPlusTreePage *child) {
+  parent->SetCountAt(parent->ValueIndex(child->GetPageId()),SubtreeCount(child));
+}
+
+/*
+ * Add delta to the count of every child on the write crabbing path, right
+ * after the leaf at its end gained or lost an entry. No page of the path has
+ * been released (see CrabingProtocalFetchPage), so the path is transaction
+ * page set up to the leaf.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::AddToPathCounts(Transaction *transaction, int delta) {
+  B_PLUS_TREE_INTERNAL_PAGE *parent = nullptr;
+  for (Page *page : *transaction->GetPageSet()) {
+    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    if (parent != nullptr) {
+      int index = parent->ValueIndex(node->GetPageId());
+      parent->SetCountAt(index,parent->CountAt(index) + delta);
+    }
+    if (node->IsLeafPage())
+      break;
+    parent = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+  }
+}
+
+/*****************************************************************************
+ * INDEX ITERATOR
+ *****************************************************************************/
+/*
+ * Input parameter is void, find the leaftmost leaf page first, then construct
+ * index iterator
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin() {
+  KeyType a;
+  B_PLUS_TREE_LEAF_PAGE_TYPE* sleaf = FindLeafPage(a, true);
+  TryUnlockRootPageId(false);
+  return INDEXITERATOR_TYPE(sleaf, 0, buffer_pool_manager_);
+}
+
+/*
+ * Input parameter is low key, find the leaf page that contains the input key
+ * first, then construct index iterator
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) {
+  B_PLUS_TREE_LEAF_PAGE_TYPE* sleaf = FindLeafPage(key);
+  TryUnlockRootPageId(false);
+  if (sleaf == nullptr) {
+    return INDEXITERATOR_TYPE(sleaf, 0, buffer_pool_manager_);
+  }else{
+    int index = sleaf->KeyIndex(key,comparator_);
+    return INDEXITERATOR_TYPE(sleaf, index, buffer_pool_manager_);
+  }
+}
+
+/*
+ * Find the rightmost leaf page first, then construct reverse index iterator
+ * @return : reverse index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+REVERSE_INDEXITERATOR_TYPE BPLUSTREE_TYPE::ReverseBegin() {
+  KeyType a;
+  Page *page = FindPrevLeafPage(a, true);
+  if (page == nullptr) {
+    return REVERSE_INDEXITERATOR_TYPE(this, nullptr, 0, buffer_pool_manager_);
+  }
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  return REVERSE_INDEXITERATOR_TYPE(this, leaf, leaf->GetSize() - 1, buffer_pool_manager_);
+}
+
+/*
+ * Input parameter is high key, find the leaf page that contains the input key
+ * first, then construct reverse index iterator from the greatest key <= key
+ * @return : reverse index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+REVERSE_INDEXITERATOR_TYPE BPLUSTREE_TYPE::ReverseBegin(const KeyType &key) {
+  Page *page;
+  if (blink_) {
+    page = BLinkFindLeafPage(key,false,false,nullptr);
+  } else {
+    KeyType upper;
+    bool hasUpper;
+    page = ScanFindLeafPage(key,upper,hasUpper);
+  }
+  if (page == nullptr) {
+    return REVERSE_INDEXITERATOR_TYPE(this, nullptr, 0, buffer_pool_manager_);
+  }
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  int index = leaf->KeyIndex(key,comparator_);
+  if (index == leaf->GetSize() || comparator_(leaf->KeyAt(index),key) != 0)
+    index--;
+  return REVERSE_INDEXITERATOR_TYPE(this, leaf, index, buffer_pool_manager_, &key);
+}
+
+/*****************************************************************************
+ * RANGE SCAN
+ *****************************************************************************/
+/*
+ * Copy key & value pairs with lo <= key <= hi (either bound exclusive if
+ * asked) into result, leaf by leaf. A leaf is read latched only while its
+ * entries are copied, so a slow consumer never blocks writers. The batch ends
+ * at a key boundary once it holds batch_size pairs, all values of a posting
+ * list go into the same batch.
+ * Between leaves the B-link mode follows the right link of the copied leaf
+ * (pages are never freed). Otherwise the next leaf may have been merged away
+ * meanwhile, so the scan descends again from the root, to the leaf holding the
+ * smallest separator greater than the copied leaf's range (see
+ * ScanFindLeafPage).
+ * @return : false means no more pairs in range, true means the caller should
+ * resume with lo = result.back().first and lo_inclusive = false
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::ScanRange(const KeyType &lo, const KeyType &hi,
+                               size_t batch_size,
+                               std::vector<MappingType> &result,
+                               bool lo_inclusive, bool hi_inclusive) {
+  result.clear();
+  if (batch_size == 0)
+    batch_size = 1;
+  // pairs <= from (< from if inclusive) are done, the next leaf is found by
+  // descending with key, or by its page id in B-link mode
+  KeyType from = lo;
+  bool inclusive = lo_inclusive;
+  KeyType key = lo;
+  page_id_t next = INVALID_PAGE_ID;
+  std::vector<ValueType> postings;
+  while (true) {
+    Page *page;
+    KeyType upper;
+    bool hasUpper = false;
+    if (blink_) {
+      if (next == INVALID_PAGE_ID) {
+        page = BLinkFindLeafPage(key,false,false,nullptr);
+      } else {
+        page = buffer_pool_manager_->FetchPage(next);
+        if (page == nullptr) {
+          throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+        }
+        page->RLatch();
+      }
+    } else {
+      page = ScanFindLeafPage(key,upper,hasUpper);
+    }
+    if (page == nullptr)
+      return false;
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+    int i = leaf->KeyIndex(from,comparator_);
+    if (!inclusive && i < leaf->GetSize() && comparator_(leaf->KeyAt(i),from) == 0)
+      i++;
+    bool done = false;
+    for (; i < leaf->GetSize(); i++) {
+      MappingType item = leaf->GetItem(i);
+      int c = comparator_(item.first,hi);
+      if (c > 0 || (c == 0 && !hi_inclusive)) {
+        done = true;
+        break;
+      }
+      if (result.size() >= batch_size)
+        break;
+      postings.clear();
+      GetPostings(item.second,postings);
+      for (const ValueType &v : postings)
+        result.push_back(MappingType(item.first,v));
+    }
+    bool exhausted = i == leaf->GetSize();
+    next = leaf->GetNextPageId();
+    if (exhausted && leaf->GetSize() > 0 &&
+        comparator_(leaf->KeyAt(leaf->GetSize() - 1),from) > 0) {
+      from = leaf->KeyAt(leaf->GetSize() - 1);
+      inclusive = false;
+    }
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    if (done)
+      return false;
+    if (!exhausted)
+      return true;
+    if (blink_ ? next == INVALID_PAGE_ID : !hasUpper)
+      return false;
+    if (result.size() >= batch_size)
+      return true;
+    if (!blink_)
+      key = upper;
+  }
+}
+
+/*
+ * Read latched leaf page for key like FindLeafPage(key), crabbing with read
+ * latches. Also returns the smallest separator greater than key seen on the
+ * way down, i.e. the lowest key of the subtree right after the leaf; there is
+ * none for the rightmost leaf.
+ * If exclusive the leaf is write latched instead (see InsertBatch), page type
+ * is read before latching as in OptimisticFindLeafPage.
+ * @return : nullptr if tree is empty
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::ScanFindLeafPage(const KeyType &key, KeyType &upper,
+                                       bool &has_upper, bool exclusive) {
+  has_upper = false;
+  LockRootPageId(false);
+  if (IsEmpty()) {
+    TryUnlockRootPageId(false);
+    return nullptr;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (page == nullptr) {
+    TryUnlockRootPageId(false);
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  Lock(exclusive && node->IsLeafPage(),page);
+  TryUnlockRootPageId(false);
+  while (!node->IsLeafPage()) {
+    B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+    page_id_t child = internalPage->Lookup(key,comparator_);
+    int index = internalPage->ValueIndex(child);
+    if (index + 1 < internalPage->GetSize()) {
+      upper = internalPage->KeyAt(index + 1);
+      has_upper = true;
+    }
+    Page *childPage = buffer_pool_manager_->FetchPage(child);
+    if (childPage == nullptr) {
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    node = reinterpret_cast<BPlusTreePage *>(childPage->GetData());
+    Lock(exclusive && node->IsLeafPage(),childPage);
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    page = childPage;
+  }
+  return page;
+}
+
+/*
+ * Read latched leaf page holding the greatest key < key, or the rightmost leaf
+ * page if rightMost: at each level take the last child whose separator is
+ * < key. Same latching as ScanFindLeafPage, except that B-link mode holds one
+ * latch at a time and moves right while the high key is < key.
+ * @return : nullptr if tree is empty
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FindPrevLeafPage(const KeyType &key, bool rightMost) {
+  LockRootPageId(false);
+  if (IsEmpty()) {
+    TryUnlockRootPageId(false);
+    return nullptr;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (page == nullptr) {
+    TryUnlockRootPageId(false);
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  page->RLatch();
+  TryUnlockRootPageId(false);
+  while (true) {
+    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    while (blink_) {
+      page_id_t right;
+      KeyType high;
+      if (node->IsLeafPage()) {
+        B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+        right = leaf->GetNextPageId();
+        high = leaf->GetHighKey();
+      } else {
+        B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+        right = internalPage->GetRightPageId();
+        high = internalPage->GetHighKey();
+      }
+      if (right == INVALID_PAGE_ID || (!rightMost && comparator_(high,key) >= 0))
+        break;
+      Page *rightPage = buffer_pool_manager_->FetchPage(right);
+      if (rightPage == nullptr) {
+        page->RUnlatch();
+        buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      }
+      rightPage->RLatch();
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+      page = rightPage;
+      node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    }
+    if (node->IsLeafPage())
+      return page;
+    B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+    int index = internalPage->GetSize() - 1;
+    if (!rightMost) {
+      index = internalPage->ValueIndex(internalPage->Lookup(key,comparator_));
+      if (index > 0 && comparator_(internalPage->KeyAt(index),key) == 0)
+        index--;
+    }
+    Page *childPage = buffer_pool_manager_->FetchPage(internalPage->ValueAt(index));
+    if (childPage == nullptr) {
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    if (!blink_)
+      childPage->RLatch();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    if (blink_)
+      childPage->RLatch();
+    page = childPage;
+  }
+}
+
+/*****************************************************************************
+ * PARALLEL SCAN
+ *****************************************************************************/
+/*
+ * Cut [lo, hi] at separator keys of the highest internal level that has at
+ * least partitions - 1 of them inside the range (or of the lowest internal
+ * level), picking evenly spaced ones so that every sub-range gets about the
+ * same number of subtrees. The keys are only a hint, the sub-ranges cover
+ * [lo, hi] whatever happens to the tree meanwhile.
+ * @return : split keys in increasing order, all in (lo, hi]. Sub-range i is
+ * [split[i-1], split[i]), the first one starts at lo and the last one is
+ * [split.back(), hi]
+ */
+INDEX_TEMPLATE_ARGUMENTS
+std::vector<KeyType> BPLUSTREE_TYPE::PartitionRange(const KeyType &lo,
+                                                    const KeyType &hi,
+                                                    size_t partitions) {
+  std::vector<KeyType> separators;
+  if (partitions <= 1 || comparator_(lo,hi) >= 0)
+    return separators;
+  for (int depth = 0; separators.size() + 1 < partitions; depth++) {
+    LockRootPageId(false);
+    if (IsEmpty()) {
+      TryUnlockRootPageId(false);
+      return separators;
+    }
+    Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+    if (page == nullptr) {
+      TryUnlockRootPageId(false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    page->RLatch();
+    TryUnlockRootPageId(false);
+    std::vector<KeyType> keys;
+    if (!CollectSeparators(page,depth,lo,hi,keys))
+      break;
+    separators.swap(keys);
+  }
+  if (separators.size() + 1 <= partitions)
+    return separators;
+  // subtree boundary j * subtrees / partitions closes partition j
+  size_t subtrees = separators.size() + 1;
+  std::vector<KeyType> split;
+  for (size_t j = 1; j < partitions; j++)
+    split.push_back(separators[j * subtrees / partitions - 1]);
+  return split;
+}
+
+/*
+ * Append the separators in (lo, hi] of the internal pages depth levels below
+ * page, visiting only subtrees that overlap [lo, hi]. Page is read latched and
+ * pinned, and released here. Crabbing mode keeps it latched while visiting
+ * children, so they can not be merged away; B-link mode releases it first,
+ * like BLinkFindLeafPage.
+ * @return : false if the pages depth levels below page are leaves
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::CollectSeparators(Page *page, int depth,
+                                       const KeyType &lo, const KeyType &hi,
+                                       std::vector<KeyType> &result) {
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (node->IsLeafPage()) {
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    return false;
+  }
+  B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+  // child i covers [KeyAt(i), KeyAt(i + 1))
+  std::vector<page_id_t> children;
+  for (int i = 0; i < internalPage->GetSize(); i++) {
+    if (i > 0 && comparator_(internalPage->KeyAt(i),hi) > 0)
+      break;
+    if (i + 1 < internalPage->GetSize() && comparator_(internalPage->KeyAt(i + 1),lo) <= 0)
+      continue;
+    if (depth > 0)
+      children.push_back(internalPage->ValueAt(i));
+    else if (i > 0 && comparator_(internalPage->KeyAt(i),lo) > 0)
+      result.push_back(internalPage->KeyAt(i));
+  }
+  if (blink_) {
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+  }
+  bool internal = true;
+  try {
+    for (page_id_t child : children) {
+      Page *childPage = buffer_pool_manager_->FetchPage(child);
+      if (childPage == nullptr) {
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      }
+      childPage->RLatch();
+      if (!CollectSeparators(childPage,depth - 1,lo,hi,result)) {
+        internal = false;
+        break;
+      }
+    }
+  } catch (...) {
+    // every level releases its own page on the way up
+    if (!blink_) {
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    }
+    throw;
+  }
+  if (!blink_) {
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+  }
+  return internal;
+}
+
+/*
+ * Scan every sub-range of PartitionRange(lo, hi, partitions) on its own
+ * thread with ScanRange, so no latch is held while consumer runs. An
+ * exception thrown by a worker is rethrown here once all workers are done.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ParallelScanRange(
+    const KeyType &lo, const KeyType &hi, size_t partitions,
+    size_t batch_size,
+    const std::function<bool(size_t, const std::vector<MappingType> &)>
+        &consumer) {
+  std::vector<KeyType> split = PartitionRange(lo,hi,partitions);
+  std::vector<std::exception_ptr> errors(split.size() + 1);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i <= split.size(); i++) {
+    workers.emplace_back([&, i] {
+      try {
+        bool last = i == split.size();
+        KeyType from = i == 0 ? lo : split[i - 1];
+        KeyType to = last ? hi : split[i];
+        bool inclusive = true;
+        std::vector<MappingType> batch;
+        bool more = true;
+        while (more) {
+          more = ScanRange(from,to,batch_size,batch,inclusive,last);
+          if (batch.empty() || !consumer(i,batch))
+            break;
+          from = batch.back().first;
+          inclusive = false;
+        }
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+  for (std::thread &worker : workers)
+    worker.join();
+  for (std::exception_ptr &error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
+/*
+ * ParallelScanRange over [smallest key, greatest key] of the tree
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ParallelScan(
+    size_t partitions, size_t batch_size,
+    const std::function<bool(size_t, const std::vector<MappingType> &)>
+        &consumer) {
+  KeyType lo, hi;
+  {
+    INDEXITERATOR_TYPE first = Begin();
+    if (first.isEnd())
+      return;
+    lo = (*first).first;
+  }
+  {
+    REVERSE_INDEXITERATOR_TYPE last = ReverseBegin();
+    if (last.isEnd())
+      return;
+    hi = (*last).first;
+  }
+  ParallelScanRange(lo,hi,partitions,batch_size,consumer);
+}
+
+/*****************************************************************************
+ * POSTING LIST
+ *****************************************************************************/
+/*
+ * Add value to the values of an existing key in a write latched leaf page. A
+ * single value stored in the leaf moves into a new posting page together with
+ * the new one. Otherwise value goes into the last posting page whose first
+ * record id is not greater, which is split first if full.
+ * @param   old_value      value of key in leaf page
+ * @return : false if key & value pair already exists
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::InsertPosting(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf,
+                                   const KeyType &key,
+                                   const ValueType &old_value,
+                                   const ValueType &value) {
+  if (!BPlusTreePostingPage::IsReference(old_value)) {
+    if (old_value == value)
+      return false;
+    page_id_t pid;
+    Page *page = buffer_pool_manager_->NewPage(pid);
+    if (page == nullptr)
+      throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+    BPlusTreePostingPage *posting = reinterpret_cast<BPlusTreePostingPage *>(page->GetData());
+    posting->Init(pid);
+    posting->Insert(old_value);
+    posting->Insert(value);
+    buffer_pool_manager_->UnpinPage(pid,true);
+    leaf->SetValue(key,BPlusTreePostingPage::MakeReference(pid),comparator_);
+    return true;
+  }
+  Page *page = buffer_pool_manager_->FetchPage(old_value.GetPageId());
+  if (page == nullptr)
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  BPlusTreePostingPage *posting = reinterpret_cast<BPlusTreePostingPage *>(page->GetData());
+  while (posting->GetNextPageId() != INVALID_PAGE_ID) {
+    Page *next = buffer_pool_manager_->FetchPage(posting->GetNextPageId());
+    if (next == nullptr) {
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    BPlusTreePostingPage *nextPosting = reinterpret_cast<BPlusTreePostingPage *>(next->GetData());
+    if (value.Get() < nextPosting->RIDAt(0).Get()) {
+      buffer_pool_manager_->UnpinPage(next->GetPageId(),false);
+      break;
+    }
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    page = next;
+    posting = nextPosting;
+  }
+  if (posting->Contains(value)) {
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    return false;
+  }
+  if (posting->GetSize() == posting->GetMaxSize()) {
+    page_id_t pid;
+    Page *newPage = buffer_pool_manager_->NewPage(pid);
+    if (newPage == nullptr) {
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+    }
+    BPlusTreePostingPage *newPosting = reinterpret_cast<BPlusTreePostingPage *>(newPage->GetData());
+    newPosting->Init(pid);
+    posting->MoveHalfTo(newPosting);
+    if (value.Get() < newPosting->RIDAt(0).Get())
+      posting->Insert(value);
+    else
+      newPosting->Insert(value);
+    buffer_pool_manager_->UnpinPage(pid,true);
+  } else {
+    posting->Insert(value);
+  }
+  buffer_pool_manager_->UnpinPage(page->GetPageId(),true);
+  return true;
+}
+
+/*
+ * Remove value (all values if null) of key from its posting list in a write
+ * latched leaf page. Emptied posting pages are unlinked and deleted, and a
+ * posting list left with a single value is moved back into the leaf.
+ * @return : true means the key itself should be removed from leaf page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::RemovePosting(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf,
+                                   const KeyType &key,
+                                   const ValueType *value) {
+  ValueType v;
+  if (!leaf->Lookup(key,v,comparator_))
+    return false;
+  if (!BPlusTreePostingPage::IsReference(v))
+    return value == nullptr || *value == v;
+  if (value == nullptr) {
+    // the whole chain is read before any page of it is freed
+    std::vector<page_id_t> pids;
+    for (page_id_t pid = v.GetPageId(); pid != INVALID_PAGE_ID;) {
+      Page *page = buffer_pool_manager_->FetchPage(pid);
+      if (page == nullptr)
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      page_id_t next = reinterpret_cast<BPlusTreePostingPage *>(page->GetData())->GetNextPageId();
+      buffer_pool_manager_->UnpinPage(pid,false);
+      pids.push_back(pid);
+      pid = next;
+    }
+    for (page_id_t pid : pids)
+      FreePage(pid);
+    return true;
+  }
+  // find the page holding value, remembering its predecessor
+  page_id_t head = v.GetPageId();
+  Page *prev = nullptr;
+  Page *page = buffer_pool_manager_->FetchPage(head);
+  if (page == nullptr)
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  BPlusTreePostingPage *posting = reinterpret_cast<BPlusTreePostingPage *>(page->GetData());
+  while (!posting->Remove(*value)) {
+    page_id_t next = posting->GetNextPageId();
+    if (prev != nullptr)
+      buffer_pool_manager_->UnpinPage(prev->GetPageId(),false);
+    prev = page;
+    if (next == INVALID_PAGE_ID) {
+      buffer_pool_manager_->UnpinPage(prev->GetPageId(),false);
+      return false;
+    }
+    page = buffer_pool_manager_->FetchPage(next);
+    if (page == nullptr) {
+      buffer_pool_manager_->UnpinPage(prev->GetPageId(),false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    posting = reinterpret_cast<BPlusTreePostingPage *>(page->GetData());
+  }
+  if (posting->GetSize() == 0) {
+    page_id_t pid = page->GetPageId();
+    if (prev == nullptr) {
+      head = posting->GetNextPageId();
+    } else {
+      reinterpret_cast<BPlusTreePostingPage *>(prev->GetData())->SetNextPageId(posting->GetNextPageId());
+    }
+    buffer_pool_manager_->UnpinPage(pid,false);
+    FreePage(pid);
+  } else {
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),true);
+  }
+  if (prev != nullptr)
+    buffer_pool_manager_->UnpinPage(prev->GetPageId(),true);
+  // the list keeps at least one value, head may have moved
+  leaf->SetValue(key,BPlusTreePostingPage::MakeReference(head),comparator_);
+  // a single value left goes back into the leaf
+  page = buffer_pool_manager_->FetchPage(head);
+  if (page == nullptr)
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  posting = reinterpret_cast<BPlusTreePostingPage *>(page->GetData());
+  if (posting->GetSize() == 1 && posting->GetNextPageId() == INVALID_PAGE_ID) {
+    leaf->SetValue(key,posting->RIDAt(0),comparator_);
+    buffer_pool_manager_->UnpinPage(head,false);
+    FreePage(head);
+  } else {
+    buffer_pool_manager_->UnpinPage(head,false);
+  }
+  return false;
+}
+
+/*
+ * Append the value(s) that a leaf page value stands for to result
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::GetPostings(const ValueType &value,
+                                 std::vector<ValueType> &result) {
+  if (!BPlusTreePostingPage::IsReference(value)) {
+    result.push_back(value);
+    return;
+  }
+  for (page_id_t pid = value.GetPageId(); pid != INVALID_PAGE_ID;) {
+    Page *page = buffer_pool_manager_->FetchPage(pid);
+    if (page == nullptr)
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    BPlusTreePostingPage *posting = reinterpret_cast<BPlusTreePostingPage *>(page->GetData());
+    for (int i = 0; i < posting->GetSize(); i++)
+      result.push_back(posting->RIDAt(i));
+    page_id_t next = posting->GetNextPageId();
+    buffer_pool_manager_->UnpinPage(pid,false);
+    pid = next;
+  }
+}
+
+/*****************************************************************************
+ * B-LINK
+ *****************************************************************************/
+/*
+ * Find leaf page containing particular key in B-link mode. Only one page is
+ * latched at a time (plus its right sibling while moving right), internal
+ * pages in shared mode and the leaf in exclusive mode if asked. Pages are
+ * never freed in a B-link tree, so page type can be read before latching.
+ * @param   path      if not null, collects internal page ids from root down
+ * @return : latched and pinned leaf page, nullptr if tree is empty
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::BLinkFindLeafPage(const KeyType &key, bool leftMost,
+                                        bool exclusive,
+                                        std::vector<page_id_t> *path) {
+  LockRootPageId(false);
+  if (IsEmpty()) {
+    TryUnlockRootPageId(false);
+    return nullptr;
+  }
+  page_id_t next = root_page_id_;
+  TryUnlockRootPageId(false);
+  while (true) {
+    Page *page = buffer_pool_manager_->FetchPage(next);
+    if (page == nullptr) {
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    bool isLeaf = reinterpret_cast<BPlusTreePage *>(page->GetData())->IsLeafPage();
+    Lock(exclusive && isLeaf, page);
+    if (!leftMost) {
+      page = BLinkMoveRight(page, key, exclusive && isLeaf);
+    }
+    if (isLeaf) {
+      return page;
+    }
+    B_PLUS_TREE_INTERNAL_PAGE *internalPage = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(page->GetData());
+    next = leftMost ? internalPage->ValueAt(0) : internalPage->Lookup(key,comparator_);
+    if (path != nullptr) {
+      path->push_back(page->GetPageId());
+    }
+    Unlock(false,page);
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+  }
+}
+
+/*
+ * Follow right links while key >= high key of the latched page, i.e. while a
+ * concurrent split has moved key's range to a right sibling. The right
+ * sibling is latched before the current page is released.
+ * @return : latched and pinned page whose range covers key
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::BLinkMoveRight(Page *page, const KeyType &key,
+                                     bool exclusive) {
+  while (true) {
+    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    page_id_t right;
+    if (node->IsLeafPage()) {
+      B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+      right = leaf->GetNextPageId();
+      if (right == INVALID_PAGE_ID || comparator_(key, leaf->GetHighKey()) < 0)
+        return page;
+    } else {
+      B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+      right = internalPage->GetRightPageId();
+      if (right == INVALID_PAGE_ID || comparator_(key, internalPage->GetHighKey()) < 0)
+        return page;
+    }
+    Page *rightPage = buffer_pool_manager_->FetchPage(right);
+    if (rightPage == nullptr) {
+      Unlock(exclusive,page);
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    Lock(exclusive,rightPage);
+    Unlock(exclusive,page);
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    page = rightPage;
+  }
+}
+
+/*
+ * Descend from the current root to the internal page at level (leaves are
+ * level 0) whose range covers key, used when a split reaches a page that was
+ * the root during descent but has since got a parent.
+ * @return : write latched and pinned internal page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::BLinkFetchPageAtLevel(const KeyType &key, int level) {
+  LockRootPageId(false);
+  page_id_t root = root_page_id_;
+  TryUnlockRootPageId(false);
+  // level of root = number of internal pages on the leftmost path
+  int curLevel = 0;
+  for (page_id_t cur = root; ; curLevel++) {
+    Page *page = buffer_pool_manager_->FetchPage(cur);
+    if (page == nullptr) {
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    page->RLatch();
+    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    page_id_t child = node->IsLeafPage() ? INVALID_PAGE_ID :
+                      static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node)->ValueAt(0);
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(cur,false);
+    if (child == INVALID_PAGE_ID) break;
+    cur = child;
+  }
+  assert(curLevel >= level);
+  Page *page = buffer_pool_manager_->FetchPage(root);
+  for (; ; curLevel--) {
+    if (page == nullptr) {
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    Lock(curLevel == level,page);
+    page = BLinkMoveRight(page, key, curLevel == level);
+    if (curLevel == level) return page;
+    B_PLUS_TREE_INTERNAL_PAGE *internalPage = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(page->GetData());
+    page_id_t next = internalPage->Lookup(key,comparator_);
+    Unlock(false,page);
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+    page = buffer_pool_manager_->FetchPage(next);
+  }
+}
+
+/*
+ * Insert in B-link mode: only the target leaf is write latched. On overflow
+ * the leaf is split and released before its parent is latched (see
+ * BLinkSplit).
+ * @return: false for duplicate key
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::BLinkInsert(const KeyType &key, const ValueType &value) {
+  std::vector<page_id_t> path;
+  Page *page = BLinkFindLeafPage(key,false,true,&path);
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  ValueType v;
+  if (leaf->Lookup(key,v,comparator_)) {
+    bool r;
+    try {
+      r = !unique_ && InsertPosting(leaf,key,v,value);
+    } catch (...) {
+      page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(),false);
+      throw;
+    }
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),r);
+    return r;
+  }
+  bool append = leaf->GetNextPageId() == INVALID_PAGE_ID &&
+                (leaf->GetSize() == 0 ||
+                 comparator_(leaf->KeyAt(leaf->GetSize() - 1), key) < 0);
+  leaf->Insert(key,value,comparator_);
+  if (leaf->GetSize() > leaf->GetMaxSize()) {
+    BLinkSplit(page,path,0,append);
+  } else {
+    if (leaf->GetNextPageId() == INVALID_PAGE_ID)
+      rightmost_leaf_ = page->GetPageId();
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),true);
+  }
+  return true;
+}
+
+/*
+ * Split a write latched, overflowing page at level into itself and a new right
+ * sibling, which takes over its right link and high key. Readers can reach the
+ * new sibling through the right link right away, so the separator is inserted
+ * into the parent afterwards as a separate critical section. The split page
+ * stays latched only until its parent is latched, so parent updates happen in
+ * split order (latches are taken bottom-up and left to right, and readers hold
+ * one latch at a time, so this can not deadlock).
+ * @param   path      internal page ids recorded during descent
+ * @param   append    page is the last of its level and overflowed by an
+ * entry past its last one, see AppendSplitSize
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BLinkSplit(Page *page, std::vector<page_id_t> &path,
+                                int level, bool append) {
+  page_id_t leftId = page->GetPageId();
+  page_id_t rightId;
+  Page *rightPage = buffer_pool_manager_->NewPage(rightId);
+  if (rightPage == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+  }
+  KeyType key;
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (node->IsLeafPage()) {
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+    B_PLUS_TREE_LEAF_PAGE_TYPE *sibling = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(rightPage->GetData());
+    InitPage(sibling, rightId);
+    sibling->ReserveHighKey();
+    leaf->MoveHalfTo(sibling,buffer_pool_manager_,append ? AppendSplitSize(leaf) : -1);
+    UpdatePrevPageId(sibling);
+    if (sibling->GetNextPageId() != INVALID_PAGE_ID)
+      sibling->SetHighKey(leaf->GetHighKey());
+    else
+      rightmost_leaf_ = rightId;
+    key = sibling->KeyAt(0);
+    leaf->SetHighKey(key);
+  } else {
+    B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+    B_PLUS_TREE_INTERNAL_PAGE *sibling = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(rightPage->GetData());
+    InitPage(sibling, rightId);
+    sibling->ReserveHighKey();
+    internalPage->MoveHalfTo(sibling,buffer_pool_manager_,append ? AppendSplitSize(internalPage) : -1);
+    sibling->SetRightPageId(internalPage->GetRightPageId());
+    if (sibling->GetRightPageId() != INVALID_PAGE_ID)
+      sibling->SetHighKey(internalPage->GetHighKey());
+    key = sibling->KeyAt(0);
+    internalPage->SetRightPageId(rightId);
+    internalPage->SetHighKey(key);
+  }
+  buffer_pool_manager_->UnpinPage(rightId,true);
+
+  if (path.empty()) {
+    LockRootPageId(true);
+    if (root_page_id_ == leftId) {
+      page_id_t newRootId;
+      Page *np = buffer_pool_manager_->NewPage(newRootId);
+      if (np == nullptr) {
+        TryUnlockRootPageId(true);
+        throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+      }
+      B_PLUS_TREE_INTERNAL_PAGE *nr = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(np->GetData());
+      InitPage(nr, newRootId);
+      nr->SetRootPage(true);
+      nr->ReserveHighKey();
+      nr->PopulateNewRoot(leftId,key,rightId);
+      node->SetRootPage(false);
+      root_page_id_ = newRootId;
+      UpdateRootPageId();
+      buffer_pool_manager_->UnpinPage(newRootId,true);
+      TryUnlockRootPageId(true);
+      page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(leftId,true);
+      return;
+    }
+    TryUnlockRootPageId(true);
+  }
+
+  Page *parentPage;
+  try {
+    if (path.empty()) {
+      parentPage = BLinkFetchPageAtLevel(key,level + 1);
+    } else {
+      parentPage = buffer_pool_manager_->FetchPage(path.back());
+      if (parentPage == nullptr) {
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      }
+      path.pop_back();
+      parentPage->WLatch();
+      parentPage = BLinkMoveRight(parentPage,key,true);
+    }
+  } catch (...) {
+    // the new sibling stays reachable through the right link, its separator
+    // is missing from the parent
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(leftId,true);
+    throw;
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(leftId,true);
+  B_PLUS_TREE_INTERNAL_PAGE *parent = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(parentPage->GetData());
+  assert(parent->ValueIndex(leftId) != -1);
+  int size = parent->InsertNodeAfter(leftId,key,rightId);
+  if (size > parent->GetMaxSize()) {
+    BLinkSplit(parentPage,path,level + 1,
+               parent->GetRightPageId() == INVALID_PAGE_ID &&
+                   parent->ValueAt(size - 1) == rightId);
+  } else {
+    parentPage->WUnlatch();
+    buffer_pool_manager_->UnpinPage(parentPage->GetPageId(),true);
+  }
+}
+
+/*
+ * Remove in B-link mode: delete from the write latched leaf only. Nodes are
+ * allowed to underflow and are never merged, so a page id seen by a
+ * concurrent reader always stays valid.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BLinkRemove(const KeyType &key, const ValueType *value) {
+  Page *page = BLinkFindLeafPage(key,false,true,nullptr);
+  if (page == nullptr) return;
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  bool remove;
+  try {
+    remove = RemovePosting(leaf,key,value);
+  } catch (...) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),true);
+    throw;
+  }
+  if (remove) {
+    int oldSize = leaf->GetSize();
+    if (leaf->RemoveAndDeleteRecord(key,comparator_) < oldSize &&
+        bloom_filter_ != nullptr)
+      bloom_filter_->CountRemove();
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(),true);
+}
+
+/*
+ * Range delete in B-link mode: trim the write latched leaves of [lo, hi] from
+ * left to right, following right links as a reader does. As in BLinkRemove
+ * nodes are allowed to underflow and nothing is freed.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BLinkDeleteRange(const KeyType &lo, const KeyType &hi) {
+  Page *page = BLinkFindLeafPage(lo,false,true,nullptr);
+  while (page != nullptr) {
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+    RemoveRangeFromLeaf(leaf,lo,hi,true,true);
+    Page *right = nullptr;
+    if (leaf->GetNextPageId() != INVALID_PAGE_ID &&
+        comparator_(hi, leaf->GetHighKey()) >= 0) {
+      right = buffer_pool_manager_->FetchPage(leaf->GetNextPageId());
+      if (right == nullptr) {
+        page->WUnlatch();
+        buffer_pool_manager_->UnpinPage(page->GetPageId(),true);
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      }
+      right->WLatch();
+    }
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(),true);
+    page = right;
+  }
+}
+
+/*****************************************************************************
+ * UTILITIES AND DEBUG
+ *****************************************************************************/
+/*
+ * Find leaf page containing particular key, if leftMost flag == true, find
+ * the left most leaf page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+B_PLUS_TREE_LEAF_PAGE_TYPE *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key,
+                                                         bool leftMost,OpType op,
+                                                         Transaction *transaction) {
+  bool jug = (op != OpType::SEARCH);
+  if (blink_) {
+    Page *page = BLinkFindLeafPage(key,leftMost,jug,nullptr);
+    return page == nullptr ? nullptr : reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  }
+  if (jug && optimisticLatch && !counted_ && !leftMost && transaction != nullptr) {
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf;
+    if (OptimisticFindLeafPage(key, op, leaf, transaction)) {
+      return leaf;
+    }
+  }
+  LockRootPageId(jug);
+  if (IsEmpty()) {
+    TryUnlockRootPageId(jug);
+    return nullptr;
+  }
+  BPlusTreePage* p = CrabingProtocalFetchPage(root_page_id_,op,-1,transaction);
+  page_id_t next;
+  for (page_id_t cur = root_page_id_; !p->IsLeafPage(); p =
+          CrabingProtocalFetchPage(next,op,cur,transaction),cur = next) {
+    B_PLUS_TREE_INTERNAL_PAGE *internalPage = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(p);
+    if (leftMost) {
+      next = internalPage->ValueAt(0);
+    }else {
+      next = internalPage->Lookup(key,comparator_);
+    }
+  }
+  return static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(p);
+}
+
+/*
+ * Optimistic descent for insert/delete: lock root page id and internal pages
+ * in shared mode, write latch only the leaf. If the leaf is safe for op no
+ * split or merge can reach its ancestors, so the leaf latch alone is enough.
+ * Page type is read before latching: it never changes while the page is
+ * reachable from a latched parent (or from root page id).
+ * @return : false means the leaf is unsafe, caller should restart with write
+ * crabbing from the root; otherwise leaf is write latched and in page set
+ * (nullptr for an empty tree)
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::OptimisticFindLeafPage(const KeyType &key, OpType op,
+                                            B_PLUS_TREE_LEAF_PAGE_TYPE *&leaf,
+                                            Transaction *transaction) {
+  LockRootPageId(false);
+  if (IsEmpty()) {
+    TryUnlockRootPageId(false);
+    leaf = nullptr;
+    return true;
+  }
+  Page *parent = nullptr;
+  Page *page = buffer_pool_manager_->FetchPage(root_page_id_);
+  if (page == nullptr) {
+    TryUnlockRootPageId(false);
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  while (true) {
+    Lock(node->IsLeafPage(), page);
+    if (parent == nullptr) {
+      TryUnlockRootPageId(false);
+    } else {
+      parent->RUnlatch();
+      buffer_pool_manager_->UnpinPage(parent->GetPageId(), false);
+    }
+    if (node->IsLeafPage()) break;
+    page_id_t next = static_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node)->Lookup(key,comparator_);
+    parent = page;
+    page = buffer_pool_manager_->FetchPage(next);
+    if (page == nullptr) {
+      parent->RUnlatch();
+      buffer_pool_manager_->UnpinPage(parent->GetPageId(), false);
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  }
+  if (node->IsSafe(op, MergeSize(node))) {
+    transaction->AddIntoPageSet(page);
+    leaf = static_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+    return true;
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+  return false;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+BPlusTreePage *BPLUSTREE_TYPE::FetchPage(page_id_t page_id) {
+  Page* page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  return reinterpret_cast<BPlusTreePage *>(page->GetData());
+}
+/*
+ * Parent of a page on the write crabbing path. Pages are added to transaction
+ * page set root first (siblings and split pages only after the leaf), and an
+ * ancestor is only released once a safe page below it is latched, so the
+ * parent of an unsafe page is the page right before it.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+B_PLUS_TREE_INTERNAL_PAGE *BPLUSTREE_TYPE::GetParentPage(BPlusTreePage *node,
+                                                         Transaction *transaction) {
+  auto pageSet = transaction->GetPageSet();
+  for (auto it = pageSet->begin(); it != pageSet->end(); ++it) {
+    if ((*it)->GetPageId() == node->GetPageId()) {
+      assert(it != pageSet->begin());
+      return reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>((*std::prev(it))->GetData());
+    }
+  }
+  throw Exception(EXCEPTION_TYPE_INDEX, "parent page is not latched");
+}
+
+/*
+ * A writer of a counted tree keeps every ancestor (and root page id) latched
+ * even below a safe page: the counts of the whole path change.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+BPlusTreePage *BPLUSTREE_TYPE::CrabingProtocalFetchPage(page_id_t page_id,OpType op,page_id_t previous, Transaction *transaction) {
+  bool jug = (op != OpType::SEARCH);
+  Page* page = buffer_pool_manager_->FetchPage(page_id);
+  Lock(jug,page);
+  BPlusTreePage* treePage = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  if (previous > 0 && (!jug || (!counted_ && treePage->IsSafe(op, MergeSize(treePage))))) 
+    FreePagesInTransaction(jug,transaction,previous);
+  if (transaction != nullptr)
     transaction->AddIntoPageSet(page);
   return treePage;
 }
@@ -448,11 +2963,40 @@ void BPLUSTREE_TYPE::FreePagesInTransaction(bool exclusive, Transaction *transac
     Unlock(exclusive,page);
     buffer_pool_manager_->UnpinPage(curPid,exclusive);
     if (transaction->GetDeletedPageSet()->find(curPid) != transaction->GetDeletedPageSet()->end()) {
-      buffer_pool_manager_->DeletePage(curPid);
+      FreePage(curPid);
       transaction->GetDeletedPageSet()->erase(curPid);
     }
   }
   transaction->GetPageSet()->clear();
+  FreePendingPages();
+}
+
+/*
+ * Delete a page unlinked from the tree. A reader that reached it through a
+ * stored page id (reverse iterator, adaptive hash, rightmost leaf) may still
+ * pin it, then DeletePage fails and the page is kept on a retry list until
+ * that reader unpins it or the next structural operation ends.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::FreePage(page_id_t page_id) {
+  if (buffer_pool_manager_->DeletePage(page_id))
+    return;
+  std::lock_guard<std::mutex> guard(pending_free_mutex_);
+  pending_free_.push_back(page_id);
+  has_pending_free_ = true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::FreePendingPages() {
+  if (!has_pending_free_)
+    return;
+  std::lock_guard<std::mutex> guard(pending_free_mutex_);
+  pending_free_.erase(std::remove_if(pending_free_.begin(),pending_free_.end(),
+                                     [this](page_id_t pid) {
+                                       return buffer_pool_manager_->DeletePage(pid);
+                                     }),
+                      pending_free_.end());
+  has_pending_free_ = !pending_free_.empty();
 }
 
 /*
@@ -588,17 +3132,20 @@ int BPLUSTREE_TYPE::isBalanced(page_id_t pid) {
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-bool BPLUSTREE_TYPE::isPageCorr(page_id_t pid,pair<KeyType,KeyType> &out) {
+bool BPLUSTREE_TYPE::isPageCorr(page_id_t pid,pair<KeyType,KeyType> &out,bool rightmost) {
   if (IsEmpty()) return true;
   auto node = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(pid));
   if (node == nullptr) {
     throw Exception(EXCEPTION_TYPE_INDEX,"all page are pinned while isPageCorr");
   }
   bool ret = true;
+  // with appendSplitFill above 0.5 a split of the rightmost path on append
+  // may leave its new pages sparse
+  int minSize = rightmost && appendSplitFill > 0.5 ? 1 : MergeSize(node);
   if (node->IsLeafPage())  {
     auto page = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(node);
     int size = page->GetSize();
-    ret = ret && (size >= node->GetMinSize() && size <= node->GetMaxSize());
+    ret = ret && (blink_ || (size >= minSize && size <= node->GetMaxSize()));
     for (int i = 1; i < size; i++) {
       if (comparator_(page->KeyAt(i-1), page->KeyAt(i)) > 0) {
         ret = false;
@@ -609,13 +3156,13 @@ bool BPLUSTREE_TYPE::isPageCorr(page_id_t pid,pair<KeyType,KeyType> &out) {
   } else {
     auto page = reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(node);
     int size = page->GetSize();
-    ret = ret && (size >= node->GetMinSize() && size <= node->GetMaxSize());
+    ret = ret && (blink_ || (size >= minSize && size <= node->GetMaxSize()));
     pair<KeyType,KeyType> left,right;
     for (int i = 1; i < size; i++) {
       if (i == 1) {
-        ret = ret && isPageCorr(page->ValueAt(0),left);
+        ret = ret && isPageCorr(page->ValueAt(0),left,false);
       }
-      ret = ret && isPageCorr(page->ValueAt(i),right);
+      ret = ret && isPageCorr(page->ValueAt(i),right,rightmost && i == size - 1);
       ret = ret && (comparator_(page->KeyAt(i) ,left.second)>0 && comparator_(page->KeyAt(i), right.first)<=0);
       ret = ret && (i == 1 || comparator_(page->KeyAt(i-1) , page->KeyAt(i)) < 0);
       if (!ret) break;
@@ -627,6 +3174,35 @@ bool BPLUSTREE_TYPE::isPageCorr(page_id_t pid,pair<KeyType,KeyType> &out) {
   return ret;
 }
 
+/*
+ * Number of leaf entries below pid, -1 if a count of a counted page below it
+ * is wrong
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int64_t BPLUSTREE_TYPE::isCountCorr(page_id_t pid) {
+  if (IsEmpty()) return 0;
+  auto node = reinterpret_cast<BPlusTreePage *>(buffer_pool_manager_->FetchPage(pid));
+  if (node == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX,"all page are pinned while isCountCorr");
+  }
+  int64_t ret = 0;
+  if (node->IsLeafPage()) {
+    ret = node->GetSize();
+  } else {
+    auto page = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE *>(node);
+    for (int i = 0; i < page->GetSize(); i++) {
+      int64_t cur = isCountCorr(page->ValueAt(i));
+      if (cur < 0 || (node->IsCounted() && cur != page->CountAt(i))) {
+        ret = -1;
+        break;
+      }
+      ret += cur;
+    }
+  }
+  buffer_pool_manager_->UnpinPage(pid,false);
+  return ret;
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Check(bool forceCheck) {
   if (!forceCheck && !openCheck) {
@@ -635,15 +3211,19 @@ bool BPLUSTREE_TYPE::Check(bool forceCheck) {
   pair<KeyType,KeyType> in;
   bool isPageInOrderAndSizeCorr = isPageCorr(root_page_id_, in);
   bool isBal = (isBalanced(root_page_id_) >= 0);
+  bool isCount = !counted_ || isCountCorr(root_page_id_) >= 0;
   bool isAllUnpin = buffer_pool_manager_->CheckAllUnpined();
   if (!isPageInOrderAndSizeCorr) cout<<"problem in page order or page size"<<endl;
   if (!isBal) cout<<"problem in balance"<<endl;
+  if (!isCount) cout<<"problem in subtree count"<<endl;
   if (!isAllUnpin) cout<<"problem in page unpin"<<endl;
-  return isPageInOrderAndSizeCorr && isBal && isAllUnpin;
+  return isPageInOrderAndSizeCorr && isBal && isCount && isAllUnpin;
 }
 template class BPlusTree<GenericKey<4>, RID, GenericComparator<4>>;
 template class BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
 template class BPlusTree<GenericKey<16>, RID, GenericComparator<16>>;
 template class BPlusTree<GenericKey<32>, RID, GenericComparator<32>>;
 template class BPlusTree<GenericKey<64>, RID, GenericComparator<64>>;
+template class BPlusTree<IntegerKey<int32_t>, RID, IntegerComparator<int32_t>>;
+template class BPlusTree<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>>;
 } // namespace scudb
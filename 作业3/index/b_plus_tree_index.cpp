@@ -2,38 +2,61 @@
  * b_plus_tree_index.cpp
  */
 
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <thread>
+
+#include "common/exception.h"
 #include "index/b_plus_tree_index.h"
 
 namespace scudb {
+/*
+ * Page of a spilled sort run: this header, then size entries in key order
+ */
+struct SortRunPageHeader {
+  page_id_t next_page_id;
+  int size;
+};
+
+// the tree holds duplicate keys unless metadata says the index is unique
+static BPlusTreeOptions TreeOptions(IndexMetadata *metadata,
+                                    BPlusTreeOptions options) {
+  options.unique = metadata->IsUnique();
+  return options;
+}
+
 /*
  * Constructor
  */
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_INDEX_TYPE::BPlusTreeIndex(IndexMetadata *metadata,
                                      BufferPoolManager *buffer_pool_manager,
-                                     page_id_t root_page_id)
+                                     page_id_t root_page_id,
+                                     const BPlusTreeOptions &options)
     : Index(metadata), comparator_(metadata->GetKeySchema()),
+      buffer_pool_manager_(buffer_pool_manager),
       container_(metadata->GetName(), buffer_pool_manager, comparator_,
-                 root_page_id) {}
+                 root_page_id, TreeOptions(metadata, options)) {}
 
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid,
                                        Transaction *transaction) {
   // construct insert index key
   KeyType index_key;
-  index_key.SetFromKey(key);
+  index_key.SetFromKey(key, GetKeySchema());
 
   container_.Insert(index_key, rid, transaction);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-void BPLUSTREE_INDEX_TYPE::DeleteEntry(const Tuple &key,
+void BPLUSTREE_INDEX_TYPE::DeleteEntry(const Tuple &key, RID rid,
                                        Transaction *transaction) {
   // construct delete index key
   KeyType index_key;
-  index_key.SetFromKey(key);
+  index_key.SetFromKey(key, GetKeySchema());
 
-  container_.Remove(index_key, transaction);
+  container_.Remove(index_key, rid, transaction);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -41,14 +64,497 @@ void BPLUSTREE_INDEX_TYPE::ScanKey(const Tuple &key, std::vector<RID> &result,
                                    Transaction *transaction) {
   // construct scan index key
   KeyType index_key;
-  index_key.SetFromKey(key);
+  index_key.SetFromKey(key, GetKeySchema());
 
   container_.GetValue(index_key, result, transaction);
 }
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ScanRange(
+    const Tuple &lo, const Tuple &hi, size_t batch_size,
+    const std::function<bool(const std::vector<RID> &)> &consumer,
+    bool lo_inclusive, bool hi_inclusive) {
+  KeyType lo_key, hi_key;
+  lo_key.SetFromKey(lo, GetKeySchema());
+  hi_key.SetFromKey(hi, GetKeySchema());
+
+  std::vector<MappingType> entries;
+  std::vector<RID> batch;
+  bool more = true;
+  while (more) {
+    more = container_.ScanRange(lo_key, hi_key, batch_size, entries,
+                                lo_inclusive, hi_inclusive);
+    if (entries.empty()) {
+      break;
+    }
+    batch.clear();
+    for (const MappingType &entry : entries) {
+      batch.push_back(entry.second);
+    }
+    if (!consumer(batch)) {
+      break;
+    }
+    lo_key = entries.back().first;
+    lo_inclusive = false;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_INDEX_TYPE::CountRange(const Tuple &lo, const Tuple &hi) {
+  KeyType lo_key, hi_key;
+  lo_key.SetFromKey(lo, GetKeySchema());
+  hi_key.SetFromKey(hi, GetKeySchema());
+
+  return container_.CountRange(lo_key, hi_key);
+}
+/*****************************************************************************
+ * BUILD FROM TABLE HEAP
+ *****************************************************************************/
+/*
+ * Build the index with an external merge sort instead of one InsertEntry per
+ * tuple:
+ * (1) the page chain of the heap is cut into threads contiguous slices, each
+ *     worker builds the index key of every tuple of its slice and sorts them
+ *     in runs of sort_memory / threads bytes. A full run spills to buffer pool
+ *     pages, the last one stays in memory
+ * (2) while one page of every spilled run does not fit in sort_memory, groups
+ *     of them are merged into longer runs
+ * (3) the remaining runs are merged with a heap straight into
+ *     BPlusTree::BulkLoad
+ * Tuples are read without tuple locks, the caller keeps writers out of the
+ * table until the build returns.
+ * @throw : logging is enabled, the index is not empty or a key is duplicated
+ * in a unique index; spilled runs are freed
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::BuildFromTableHeap(page_id_t first_page_id,
+                                              Schema *tuple_schema,
+                                              size_t threads,
+                                              size_t sort_memory,
+                                              double fill_factor) {
+  if (ENABLE_LOGGING) {
+    throw Exception(EXCEPTION_TYPE_INDEX,
+                    "index build reads the table without tuple locks");
+  }
+  if (!container_.IsEmpty()) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "build into a non-empty index");
+  }
+  // the heap is a linked list, only page headers are read here
+  std::vector<page_id_t> pages;
+  for (page_id_t page_id = first_page_id; page_id != INVALID_PAGE_ID;) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (page == nullptr) {
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    pages.push_back(page_id);
+    page->RLatch();
+    page_id_t next_page_id = static_cast<TablePage *>(page)->GetNextPageId();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, false);
+    page_id = next_page_id;
+  }
+
+  threads = std::max<size_t>(1, std::min(threads, pages.size()));
+  size_t run_size =
+      std::max<size_t>(1, sort_memory / threads / sizeof(MappingType));
+  std::vector<std::vector<SortRun>> worker_runs(threads);
+  std::vector<std::exception_ptr> errors(threads);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back([&, i] {
+      try {
+        ExtractKeys(pages, pages.size() * i / threads,
+                    pages.size() * (i + 1) / threads, tuple_schema, run_size,
+                    worker_runs[i]);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  // runs never move once merging starts
+  std::deque<SortRun> runs;
+  for (std::vector<SortRun> &worker_run : worker_runs) {
+    for (SortRun &run : worker_run) {
+      runs.push_back(std::move(run));
+    }
+  }
+
+  try {
+    for (std::exception_ptr &error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+
+    size_t ways = std::max<size_t>(2, sort_memory / PAGE_SIZE);
+    size_t page_entries =
+        (PAGE_SIZE - sizeof(SortRunPageHeader)) / sizeof(MappingType);
+    std::deque<SortRun *> spilled;
+    for (SortRun &run : runs) {
+      if (run.page_id != INVALID_PAGE_ID) {
+        spilled.push_back(&run);
+      }
+    }
+    while (spilled.size() > ways) {
+      RunMerger merger;
+      for (size_t i = 0; i < ways; i++) {
+        merger.runs.push_back(spilled.front());
+        spilled.pop_front();
+      }
+      StartMerge(merger);
+      runs.emplace_back();
+      SortRun &merged = runs.back();
+      page_id_t tail = INVALID_PAGE_ID;
+      std::vector<MappingType> entries;
+      MappingType item;
+      while (MergeNext(merger, item)) {
+        entries.push_back(item);
+        if (entries.size() == page_entries) {
+          SpillRun(merged, tail, entries);
+          entries.clear();
+        }
+      }
+      SpillRun(merged, tail, entries);
+      spilled.push_back(&merged);
+    }
+
+    // drained runs are empty and drop out of the heap
+    RunMerger merger;
+    for (SortRun &run : runs) {
+      merger.runs.push_back(&run);
+    }
+    StartMerge(merger);
+    container_.BulkLoad(
+        [&](MappingType &item) { return MergeNext(merger, item); },
+        fill_factor);
+  } catch (...) {
+    for (SortRun &run : runs) {
+      FreeRun(run);
+    }
+    throw;
+  }
+}
+
+/*
+ * Worker of BuildFromTableHeap: index keys of the tuples in
+ * pages[begin, end), sorted into runs of run_size entries
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ExtractKeys(const std::vector<page_id_t> &pages,
+                                       size_t begin, size_t end,
+                                       Schema *tuple_schema, size_t run_size,
+                                       std::vector<SortRun> &runs) {
+  Schema *key_schema = GetKeySchema();
+  const std::vector<int> &key_attrs = GetKeyAttrs();
+  auto less = [this](const MappingType &a, const MappingType &b) {
+    return comparator_(a.first, b.first) < 0;
+  };
+  std::vector<MappingType> entries;
+  std::vector<Value> values;
+  for (size_t i = begin; i < end; i++) {
+    Page *page = buffer_pool_manager_->FetchPage(pages[i]);
+    if (page == nullptr) {
+      throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+    }
+    TablePage *table_page = static_cast<TablePage *>(page);
+    page->RLatch();
+    RID rid;
+    Tuple tuple;
+    for (bool found = table_page->GetFirstTupleRid(rid); found;
+         found = table_page->GetNextTupleRid(rid, rid)) {
+      if (!table_page->GetTuple(rid, tuple, nullptr, nullptr)) {
+        continue;
+      }
+      values.clear();
+      for (int attr : key_attrs) {
+        values.push_back(tuple.GetValue(tuple_schema, attr));
+      }
+      KeyType index_key;
+      index_key.SetFromKey(Tuple(values, key_schema), key_schema);
+      entries.push_back(MappingType(index_key, rid));
+    }
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(pages[i], false);
+
+    if (entries.size() >= run_size) {
+      std::sort(entries.begin(), entries.end(), less);
+      runs.emplace_back();
+      page_id_t tail = INVALID_PAGE_ID;
+      SpillRun(runs.back(), tail, entries);
+      entries.clear();
+    }
+  }
+  std::sort(entries.begin(), entries.end(), less);
+  runs.emplace_back();
+  runs.back().entries.swap(entries);
+}
+
+/*
+ * Append entries to the page chain of run, after page tail (INVALID_PAGE_ID
+ * for a new run). tail is moved to the last page written.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::SpillRun(SortRun &run, page_id_t &tail,
+                                    const std::vector<MappingType> &entries) {
+  size_t page_entries =
+      (PAGE_SIZE - sizeof(SortRunPageHeader)) / sizeof(MappingType);
+  for (size_t i = 0; i < entries.size(); i += page_entries) {
+    Page *prev = nullptr;
+    if (tail != INVALID_PAGE_ID) {
+      prev = buffer_pool_manager_->FetchPage(tail);
+      if (prev == nullptr) {
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      }
+    }
+    page_id_t page_id;
+    Page *page = buffer_pool_manager_->NewPage(page_id);
+    if (page == nullptr) {
+      if (prev != nullptr) {
+        buffer_pool_manager_->UnpinPage(tail, false);
+      }
+      throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+    }
+    auto *header = reinterpret_cast<SortRunPageHeader *>(page->GetData());
+    header->next_page_id = INVALID_PAGE_ID;
+    header->size = static_cast<int>(std::min(page_entries, entries.size() - i));
+    memcpy(static_cast<void *>(page->GetData() + sizeof(SortRunPageHeader)),
+           entries.data() + i, header->size * sizeof(MappingType));
+    buffer_pool_manager_->UnpinPage(page_id, true);
+
+    if (prev != nullptr) {
+      reinterpret_cast<SortRunPageHeader *>(prev->GetData())->next_page_id =
+          page_id;
+      buffer_pool_manager_->UnpinPage(tail, true);
+    } else {
+      run.page_id = page_id;
+    }
+    tail = page_id;
+  }
+}
+
+/*
+ * Store the next entry of run in item, a spilled page is deleted once read
+ * @return : false if run is drained
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_INDEX_TYPE::ReadRun(SortRun &run, MappingType &item) {
+  if (run.page_id == INVALID_PAGE_ID) {
+    if (run.next == run.entries.size()) {
+      return false;
+    }
+    item = run.entries[run.next++];
+    return true;
+  }
+  while (run.page_id != INVALID_PAGE_ID) {
+    if (run.page == nullptr) {
+      run.page = buffer_pool_manager_->FetchPage(run.page_id);
+      if (run.page == nullptr) {
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      }
+    }
+    auto *header = reinterpret_cast<SortRunPageHeader *>(run.page->GetData());
+    if (run.next < static_cast<size_t>(header->size)) {
+      memcpy(static_cast<void *>(&item),
+             run.page->GetData() + sizeof(SortRunPageHeader) +
+                 run.next * sizeof(MappingType),
+             sizeof(MappingType));
+      run.next++;
+      return true;
+    }
+    page_id_t next_page_id = header->next_page_id;
+    buffer_pool_manager_->UnpinPage(run.page_id, false);
+    buffer_pool_manager_->DeletePage(run.page_id);
+    run.page = nullptr;
+    run.page_id = next_page_id;
+    run.next = 0;
+  }
+  return false;
+}
+
+/*
+ * Delete the pages of run that were not read yet
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::FreeRun(SortRun &run) {
+  if (run.page != nullptr) {
+    buffer_pool_manager_->UnpinPage(run.page_id, false);
+    run.page = nullptr;
+  }
+  while (run.page_id != INVALID_PAGE_ID) {
+    Page *page = buffer_pool_manager_->FetchPage(run.page_id);
+    if (page == nullptr) {
+      break;
+    }
+    page_id_t next_page_id =
+        reinterpret_cast<SortRunPageHeader *>(page->GetData())->next_page_id;
+    buffer_pool_manager_->UnpinPage(run.page_id, false);
+    buffer_pool_manager_->DeletePage(run.page_id);
+    run.page_id = next_page_id;
+  }
+  run.entries.clear();
+  run.next = 0;
+}
+
+/*
+ * Read the first entry of every run of merger into a heap on key, equal keys
+ * come out in run order
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::StartMerge(RunMerger &merger) {
+  merger.heads.resize(merger.runs.size());
+  merger.heap.clear();
+  for (size_t i = 0; i < merger.runs.size(); i++) {
+    if (ReadRun(*merger.runs[i], merger.heads[i])) {
+      merger.heap.push_back(i);
+    }
+  }
+  std::make_heap(merger.heap.begin(), merger.heap.end(),
+                 [&](size_t a, size_t b) {
+                   int c = comparator_(merger.heads[a].first,
+                                       merger.heads[b].first);
+                   return c > 0 || (c == 0 && a > b);
+                 });
+}
+
+/*
+ * Pop the smallest entry of merger into item and refill from its run
+ * @return : false if all runs are drained
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_INDEX_TYPE::MergeNext(RunMerger &merger, MappingType &item) {
+  if (merger.heap.empty()) {
+    return false;
+  }
+  auto greater = [&](size_t a, size_t b) {
+    int c = comparator_(merger.heads[a].first, merger.heads[b].first);
+    return c > 0 || (c == 0 && a > b);
+  };
+  std::pop_heap(merger.heap.begin(), merger.heap.end(), greater);
+  size_t i = merger.heap.back();
+  item = merger.heads[i];
+  if (ReadRun(*merger.runs[i], merger.heads[i])) {
+    std::push_heap(merger.heap.begin(), merger.heap.end(), greater);
+  } else {
+    merger.heap.pop_back();
+  }
+  return true;
+}
+
 template class BPlusTreeIndex<GenericKey<4>, RID, GenericComparator<4>>;
 template class BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>>;
 template class BPlusTreeIndex<GenericKey<16>, RID, GenericComparator<16>>;
 template class BPlusTreeIndex<GenericKey<32>, RID, GenericComparator<32>>;
 template class BPlusTreeIndex<GenericKey<64>, RID, GenericComparator<64>>;
+template class BPlusTreeIndex<IntegerKey<int32_t>, RID, IntegerComparator<int32_t>>;
+template class BPlusTreeIndex<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>>;
+
+/*
+ * Construct the index, then fill it from the table heap at first_page_id
+ * unless that is INVALID_PAGE_ID. A failed build deletes the index together
+ * with metadata.
+ */
+template <typename KeyType, typename KeyComparator>
+static Index *NewBPlusTreeIndex(IndexMetadata *metadata,
+                                BufferPoolManager *buffer_pool_manager,
+                                page_id_t root_page_id,
+                                const BPlusTreeOptions &options,
+                                page_id_t first_page_id, Schema *tuple_schema,
+                                size_t threads) {
+  auto *index = new BPlusTreeIndex<KeyType, RID, KeyComparator>(
+      metadata, buffer_pool_manager, root_page_id, options);
+  if (first_page_id != INVALID_PAGE_ID) {
+    try {
+      index->BuildFromTableHeap(first_page_id, tuple_schema, threads);
+    } catch (...) {
+      delete index;
+      throw;
+    }
+  }
+  return index;
+}
+
+static Index *NewBPlusTreeIndex(IndexMetadata *metadata,
+                                BufferPoolManager *buffer_pool_manager,
+                                page_id_t root_page_id,
+                                page_id_t first_page_id, Schema *tuple_schema,
+                                size_t threads) {
+  Schema *key_schema = metadata->GetKeySchema();
+  BPlusTreeOptions options;
+  // integer keys are searched with SIMD in columnar pages
+  if (key_schema->GetColumnCount() == 1) {
+    switch (key_schema->GetType(0)) {
+    case INTEGER:
+      options.columnar = true;
+      return NewBPlusTreeIndex<IntegerKey<int32_t>, IntegerComparator<int32_t>>(
+          metadata, buffer_pool_manager, root_page_id, options, first_page_id,
+          tuple_schema, threads);
+    case BIGINT:
+      options.columnar = true;
+      return NewBPlusTreeIndex<IntegerKey<int64_t>, IntegerComparator<int64_t>>(
+          metadata, buffer_pool_manager, root_page_id, options, first_page_id,
+          tuple_schema, threads);
+    default:
+      break;
+    }
+  }
+
+  // encoded length, see GenericKey
+  int key_size = 0;
+  bool varchar = false;
+  for (int i = 0; i < key_schema->GetColumnCount(); i++) {
+    const Column &column = key_schema->GetColumn(i);
+    if (column.IsInlined()) {
+      key_size += column.GetFixedLength();
+    } else {
+      key_size += column.GetVariableLength() + 2;
+      varchar = true;
+    }
+  }
+  if (key_size <= 4) {
+    return NewBPlusTreeIndex<GenericKey<4>, GenericComparator<4>>(
+        metadata, buffer_pool_manager, root_page_id, options, first_page_id,
+        tuple_schema, threads);
+  } else if (key_size <= 8) {
+    return NewBPlusTreeIndex<GenericKey<8>, GenericComparator<8>>(
+        metadata, buffer_pool_manager, root_page_id, options, first_page_id,
+        tuple_schema, threads);
+  }
+  // composite and string keys share leading bytes, keys this long take most
+  // of an entry, so pages store the shared prefix once. A varchar is mostly
+  // shorter than its max length, slotted leaves keep only its bytes.
+  options.prefix = true;
+  options.slotted = varchar;
+  if (key_size <= 16) {
+    return NewBPlusTreeIndex<GenericKey<16>, GenericComparator<16>>(
+        metadata, buffer_pool_manager, root_page_id, options, first_page_id,
+        tuple_schema, threads);
+  } else if (key_size <= 32) {
+    return NewBPlusTreeIndex<GenericKey<32>, GenericComparator<32>>(
+        metadata, buffer_pool_manager, root_page_id, options, first_page_id,
+        tuple_schema, threads);
+  }
+  // longer keys are truncated
+  return NewBPlusTreeIndex<GenericKey<64>, GenericComparator<64>>(
+      metadata, buffer_pool_manager, root_page_id, options, first_page_id,
+      tuple_schema, threads);
+}
+
+Index *CreateBPlusTreeIndex(IndexMetadata *metadata,
+                            BufferPoolManager *buffer_pool_manager,
+                            page_id_t root_page_id) {
+  return NewBPlusTreeIndex(metadata, buffer_pool_manager, root_page_id,
+                           INVALID_PAGE_ID, nullptr, 1);
+}
+
+Index *CreateBPlusTreeIndex(IndexMetadata *metadata,
+                            BufferPoolManager *buffer_pool_manager,
+                            page_id_t first_page_id, Schema *tuple_schema,
+                            size_t threads) {
+  return NewBPlusTreeIndex(metadata, buffer_pool_manager, INVALID_PAGE_ID,
+                           first_page_id, tuple_schema, threads);
+}
 
 } // namespace scudb
@@ -0,0 +1,151 @@
+/**
+ * bloom_filter.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "index/bloom_filter.h"
+#include "index/generic_key.h"
+#include "index/integer_key.h"
+
+namespace scudb {
+
+/*
+ * m = -n ln(p) / ln(2)^2 bits and k = m / n ln(2) hash functions, the
+ * optimum for n keys at false positive rate p
+ */
+template <typename KeyType>
+BloomFilter<KeyType>::Bits::Bits(size_t keys, double fp_rate) : keys(keys) {
+  double ln2 = std::log(2.0);
+  double m = -static_cast<double>(keys) * std::log(fp_rate) / (ln2 * ln2);
+  bits = std::max<uint64_t>(64, static_cast<uint64_t>(std::ceil(m)));
+  hashes = std::max(1, static_cast<int>(std::round(m / keys * ln2)));
+  size_t n = (bits + 63) / 64;
+  words.reset(new std::atomic<uint64_t>[n]);
+  for (size_t i = 0; i < n; i++)
+    words[i].store(0, std::memory_order_relaxed);
+}
+
+/*
+ * the i-th hash function is h1 + i * h2 over the two halves of hash, mapped
+ * onto [0, bits) by a multiply instead of a modulo
+ */
+template <typename KeyType>
+void BloomFilter<KeyType>::Bits::Set(uint64_t hash) {
+  uint32_t h1 = static_cast<uint32_t>(hash);
+  uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+  for (int i = 0; i < hashes; i++, h1 += h2) {
+    uint64_t bit = (static_cast<uint64_t>(h1) * bits) >> 32;
+    words[bit / 64].fetch_or(1ULL << (bit % 64), std::memory_order_relaxed);
+  }
+}
+
+template <typename KeyType>
+bool BloomFilter<KeyType>::Bits::Test(uint64_t hash) const {
+  uint32_t h1 = static_cast<uint32_t>(hash);
+  uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+  for (int i = 0; i < hashes; i++, h1 += h2) {
+    uint64_t bit = (static_cast<uint64_t>(h1) * bits) >> 32;
+    if ((words[bit / 64].load(std::memory_order_relaxed) &
+         (1ULL << (bit % 64))) == 0)
+      return false;
+  }
+  return true;
+}
+
+template <typename KeyType>
+BloomFilter<KeyType>::BloomFilter(size_t keys, double fp_rate)
+    : min_keys_(std::max<size_t>(keys, 1)),
+      fp_rate_(std::min(0.5, std::max(fp_rate, 1e-9))),
+      bits_(new Bits(min_keys_, fp_rate_)), added_(0), removed_(0),
+      stale_(false), probes_(0), negatives_(0) {}
+
+/*
+ * helper function to hash the raw key bytes: FNV-1a as in
+ * ExtendibleHashIndex::HashKey, 64 bit, with the murmur3 finalizer so that
+ * both halves are well mixed
+ */
+template <typename KeyType>
+uint64_t BloomFilter<KeyType>::HashKey(const KeyType &key) const {
+  const unsigned char *data = reinterpret_cast<const unsigned char *>(&key);
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < sizeof(KeyType); i++) {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/*
+ * bits_ and rebuilt_ only change under the exclusive insert latch
+ */
+template <typename KeyType>
+void BloomFilter<KeyType>::Add(const KeyType &key) {
+  uint64_t hash = HashKey(key);
+  if (rebuilt_ != nullptr)
+    rebuilt_->Set(hash);
+  bits_->Set(hash);
+  added_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename KeyType>
+bool BloomFilter<KeyType>::MayContain(const KeyType &key) {
+  probes_.fetch_add(1, std::memory_order_relaxed);
+  std::shared_ptr<Bits> bits = std::atomic_load(&bits_);
+  if (bits->Test(HashKey(key)))
+    return true;
+  negatives_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+template <typename KeyType>
+bool BloomFilter<KeyType>::IsStale(double ratio) const {
+  uint64_t added = added_;
+  return stale_ || removed_ > ratio * added ||
+         added > std::atomic_load(&bits_)->keys;
+}
+
+/*
+ * The new bits are sized for the keys added and not removed since the last
+ * build, with room for half as many again. Inserts in flight when the new
+ * bits are published have finished, so a key the scan misses was added
+ * after that and has set the new bits itself.
+ */
+template <typename KeyType>
+void BloomFilter<KeyType>::Rebuild(
+    const std::function<size_t(const std::function<void(const KeyType &)> &)>
+        &scan) {
+  std::lock_guard<std::mutex> guard(rebuild_mutex_);
+  std::shared_ptr<Bits> bits;
+  {
+    std::unique_lock<std::shared_mutex> latch(insert_latch_);
+    uint64_t added = added_, removed = removed_;
+    size_t live = added > removed ? added - removed : 0;
+    bits.reset(new Bits(std::max(min_keys_, live + live / 2), fp_rate_));
+    rebuilt_ = bits;
+    added_ = 0;
+    removed_ = 0;
+    stale_ = false;
+  }
+  size_t keys = scan([&](const KeyType &key) { bits->Set(HashKey(key)); });
+  std::unique_lock<std::shared_mutex> latch(insert_latch_);
+  std::atomic_store(&bits_, bits);
+  rebuilt_.reset();
+  added_ += keys;
+}
+
+template class BloomFilter<GenericKey<4>>;
+template class BloomFilter<GenericKey<8>>;
+template class BloomFilter<GenericKey<16>>;
+template class BloomFilter<GenericKey<32>>;
+template class BloomFilter<GenericKey<64>>;
+template class BloomFilter<IntegerKey<int32_t>>;
+template class BloomFilter<IntegerKey<int64_t>>;
+
+} // namespace scudb
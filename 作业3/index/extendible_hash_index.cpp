@@ -0,0 +1,289 @@
+/**
+ * extendible_hash_index.cpp
+ */
+
+#include "common/exception.h"
+#include "common/rid.h"
+#include "index/extendible_hash_index.h"
+#include "page/header_page.h"
+
+namespace scudb {
+/*
+ * Constructor
+ */
+INDEX_TEMPLATE_ARGUMENTS
+EXTENDIBLE_HASH_INDEX_TYPE::ExtendibleHashIndex(
+    IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager,
+    page_id_t directory_page_id)
+    : Index(metadata), comparator_(metadata->GetKeySchema()),
+      buffer_pool_manager_(buffer_pool_manager),
+      directory_page_id_(directory_page_id) {
+  if (!metadata->IsUnique())
+    throw Exception(EXCEPTION_TYPE_INDEX,
+                    "extendible hash index only supports unique key");
+}
+
+/*
+ * helper function to calculate the hashing address of input key
+ * (FNV-1a over the raw key bytes; equal keys are built by the same
+ * SetFromKey, so they have equal bytes)
+ */
+INDEX_TEMPLATE_ARGUMENTS
+uint32_t EXTENDIBLE_HASH_INDEX_TYPE::HashKey(const KeyType &key) const {
+  const unsigned char *data = reinterpret_cast<const unsigned char *>(&key);
+  uint32_t hash = 2166136261U;
+  for (size_t i = 0; i < sizeof(KeyType); i++) {
+    hash ^= data[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void EXTENDIBLE_HASH_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid,
+                                             Transaction *transaction) {
+  // construct insert index key
+  KeyType index_key;
+  index_key.SetFromKey(key, GetKeySchema());
+
+  mutex_.WLock();
+  try {
+    Insert(index_key, rid);
+  } catch (...) {
+    mutex_.WUnlock();
+    throw;
+  }
+  mutex_.WUnlock();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void EXTENDIBLE_HASH_INDEX_TYPE::DeleteEntry(const Tuple &key, RID rid,
+                                             Transaction *transaction) {
+  // construct delete index key
+  KeyType index_key;
+  index_key.SetFromKey(key, GetKeySchema());
+
+  mutex_.WLock();
+  if (directory_page_id_ == INVALID_PAGE_ID) {
+    mutex_.WUnlock();
+    return;
+  }
+  HashTableDirectoryPage *directory = FetchDirectoryPage();
+  page_id_t bucket_page_id = directory->GetBucketPageId(
+      HashKey(index_key) & directory->GetGlobalDepthMask());
+  HASH_TABLE_BUCKET_PAGE_TYPE *bucket = FetchBucketPage(bucket_page_id);
+  ValueType value;
+  bool removed = bucket->Lookup(index_key, value, comparator_) &&
+                 value == rid && bucket->Remove(index_key, comparator_);
+  buffer_pool_manager_->UnpinPage(bucket_page_id, removed);
+  buffer_pool_manager_->UnpinPage(directory_page_id_, false);
+  mutex_.WUnlock();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void EXTENDIBLE_HASH_INDEX_TYPE::ScanKey(const Tuple &key,
+                                         std::vector<RID> &result,
+                                         Transaction *transaction) {
+  // construct scan index key
+  KeyType index_key;
+  index_key.SetFromKey(key, GetKeySchema());
+
+  mutex_.RLock();
+  if (directory_page_id_ == INVALID_PAGE_ID) {
+    mutex_.RUnlock();
+    return;
+  }
+  HashTableDirectoryPage *directory = FetchDirectoryPage();
+  page_id_t bucket_page_id = directory->GetBucketPageId(
+      HashKey(index_key) & directory->GetGlobalDepthMask());
+  HASH_TABLE_BUCKET_PAGE_TYPE *bucket = FetchBucketPage(bucket_page_id);
+  ValueType value;
+  if (bucket->Lookup(index_key, value, comparator_)) {
+    result.push_back(value);
+  }
+  buffer_pool_manager_->UnpinPage(bucket_page_id, false);
+  buffer_pool_manager_->UnpinPage(directory_page_id_, false);
+  mutex_.RUnlock();
+}
+
+/*****************************************************************************
+ * INSERTION
+ *****************************************************************************/
+/*
+ * Insert key & value pair into its bucket, splitting the bucket (and doubling
+ * the directory if necessary) until it has room, same as
+ * ExtendibleHash::Insert
+ * @return: false if key already exists
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool EXTENDIBLE_HASH_INDEX_TYPE::Insert(const KeyType &key,
+                                        const ValueType &value) {
+  if (directory_page_id_ == INVALID_PAGE_ID) {
+    StartNewTable();
+  }
+  HashTableDirectoryPage *directory = FetchDirectoryPage();
+  bool directory_dirty = false;
+  while (true) {
+    int bucket_index = HashKey(key) & directory->GetGlobalDepthMask();
+    page_id_t bucket_page_id = directory->GetBucketPageId(bucket_index);
+    HASH_TABLE_BUCKET_PAGE_TYPE *bucket = FetchBucketPage(bucket_page_id);
+    ValueType old_value;
+    if (bucket->Lookup(key, old_value, comparator_)) {
+      buffer_pool_manager_->UnpinPage(bucket_page_id, false);
+      buffer_pool_manager_->UnpinPage(directory_page_id_, directory_dirty);
+      return false;
+    }
+    if (!bucket->IsFull()) {
+      bucket->Insert(key, value, comparator_);
+      buffer_pool_manager_->UnpinPage(bucket_page_id, true);
+      buffer_pool_manager_->UnpinPage(directory_page_id_, directory_dirty);
+      return true;
+    }
+    buffer_pool_manager_->UnpinPage(bucket_page_id, false);
+
+    if (!SplitBucket(directory, bucket_index)) {
+      buffer_pool_manager_->UnpinPage(directory_page_id_, directory_dirty);
+      throw Exception(EXCEPTION_TYPE_INDEX,
+                      "hash index directory page is full");
+    }
+    directory_dirty = true;
+  }
+}
+
+/*
+ * Split the bucket referenced by directory slot bucket_index into itself and a
+ * new bucket page, doubling the directory first when local depth == global
+ * depth
+ * @return: false if the directory can not grow any more
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool EXTENDIBLE_HASH_INDEX_TYPE::SplitBucket(HashTableDirectoryPage *directory,
+                                             int bucket_index) {
+  int local_depth = directory->GetLocalDepth(bucket_index);
+  if (local_depth == directory->GetGlobalDepth()) {
+    if (!directory->CanGrow()) {
+      return false;
+    }
+    directory->IncrGlobalDepth();
+  }
+
+  page_id_t new_page_id;
+  Page *new_page = buffer_pool_manager_->NewPage(new_page_id);
+  if (new_page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+  }
+  auto *new_bucket =
+      reinterpret_cast<HASH_TABLE_BUCKET_PAGE_TYPE *>(new_page->GetData());
+  new_bucket->Init(new_page_id);
+
+  page_id_t old_page_id = directory->GetBucketPageId(bucket_index);
+  HASH_TABLE_BUCKET_PAGE_TYPE *old_bucket = FetchBucketPage(old_page_id);
+  uint32_t mask = 1U << local_depth;
+  for (int i = 0; i < old_bucket->GetSize();) {
+    if (HashKey(old_bucket->KeyAt(i)) & mask) {
+      new_bucket->Insert(old_bucket->KeyAt(i), old_bucket->ValueAt(i),
+                         comparator_);
+      old_bucket->RemoveAt(i);
+    } else {
+      i++;
+    }
+  }
+
+  for (int i = 0; i < directory->Size(); i++) {
+    if (directory->GetBucketPageId(i) == old_page_id) {
+      directory->SetLocalDepth(i, local_depth + 1);
+      if (i & mask) {
+        directory->SetBucketPageId(i, new_page_id);
+      }
+    }
+  }
+  buffer_pool_manager_->UnpinPage(old_page_id, true);
+  buffer_pool_manager_->UnpinPage(new_page_id, true);
+  return true;
+}
+
+/*
+ * Create the directory page and its first bucket, then register the directory
+ * in header page. directory_page_id_ is only set once all of it succeeded,
+ * the pages are deleted otherwise
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void EXTENDIBLE_HASH_INDEX_TYPE::StartNewTable() {
+  page_id_t directory_page_id;
+  page_id_t bucket_page_id;
+  Page *directory_page = buffer_pool_manager_->NewPage(directory_page_id);
+  if (directory_page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+  }
+  Page *bucket_page = buffer_pool_manager_->NewPage(bucket_page_id);
+  if (bucket_page == nullptr) {
+    buffer_pool_manager_->UnpinPage(directory_page_id, false);
+    buffer_pool_manager_->DeletePage(directory_page_id);
+    throw Exception(EXCEPTION_TYPE_INDEX, "out of memory");
+  }
+  auto *directory =
+      reinterpret_cast<HashTableDirectoryPage *>(directory_page->GetData());
+  directory->Init(directory_page_id);
+  directory->SetBucketPageId(0, bucket_page_id);
+  directory->SetLocalDepth(0, 0);
+  auto *bucket =
+      reinterpret_cast<HASH_TABLE_BUCKET_PAGE_TYPE *>(bucket_page->GetData());
+  bucket->Init(bucket_page_id);
+  buffer_pool_manager_->UnpinPage(bucket_page_id, true);
+  buffer_pool_manager_->UnpinPage(directory_page_id, true);
+  try {
+    InsertDirectoryPageId(directory_page_id);
+  } catch (...) {
+    buffer_pool_manager_->DeletePage(bucket_page_id);
+    buffer_pool_manager_->DeletePage(directory_page_id);
+    throw;
+  }
+  directory_page_id_ = directory_page_id;
+}
+
+/*****************************************************************************
+ * UTILITIES
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+HashTableDirectoryPage *EXTENDIBLE_HASH_INDEX_TYPE::FetchDirectoryPage() {
+  Page *page = buffer_pool_manager_->FetchPage(directory_page_id_);
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  return reinterpret_cast<HashTableDirectoryPage *>(page->GetData());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+HASH_TABLE_BUCKET_PAGE_TYPE *
+EXTENDIBLE_HASH_INDEX_TYPE::FetchBucketPage(page_id_t bucket_page_id) {
+  Page *page = buffer_pool_manager_->FetchPage(bucket_page_id);
+  if (page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  return reinterpret_cast<HASH_TABLE_BUCKET_PAGE_TYPE *>(page->GetData());
+}
+
+/*
+ * Insert a record <index_name, directory_page_id> into header page, same as
+ * BPlusTree::UpdateRootPageId. The directory page never moves, so the record
+ * is written only once
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void EXTENDIBLE_HASH_INDEX_TYPE::InsertDirectoryPageId(
+    page_id_t directory_page_id) {
+  HeaderPage *header_page = static_cast<HeaderPage *>(
+      buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  if (header_page == nullptr) {
+    throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+  }
+  header_page->InsertRecord(GetName(), directory_page_id);
+  buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
+}
+
+template class ExtendibleHashIndex<GenericKey<4>, RID, GenericComparator<4>>;
+template class ExtendibleHashIndex<GenericKey<8>, RID, GenericComparator<8>>;
+template class ExtendibleHashIndex<GenericKey<16>, RID, GenericComparator<16>>;
+template class ExtendibleHashIndex<GenericKey<32>, RID, GenericComparator<32>>;
+template class ExtendibleHashIndex<GenericKey<64>, RID, GenericComparator<64>>;
+
+} // namespace scudb
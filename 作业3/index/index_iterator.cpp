@@ -3,6 +3,8 @@
  */
 #include <cassert>
 
+#include "common/exception.h"
+#include "index/b_plus_tree.h"
 #include "index/index_iterator.h"
 
 namespace scudb {
@@ -13,7 +15,11 @@ namespace scudb {
  */
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::IndexIterator(B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, int index, BufferPoolManager *bufferPoolManager)
-: index_(index),leaf_(leaf), bufferPoolManager_(bufferPoolManager){}
+: index_(index),leaf_(leaf), bufferPoolManager_(bufferPoolManager){
+  // Begin(key) may start right after the last key of leaf
+  MoveToNextLeaf();
+  LoadPostings();
+}
 
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::~IndexIterator() {
@@ -22,11 +28,166 @@ INDEXITERATOR_TYPE::~IndexIterator() {
   }
 }
 
+/*
+ * Read the posting list of the entry at index_, if it has one. The leaf stays
+ * read latched, which protects its posting pages.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::LoadPostings() {
+  postings_.clear();
+  posting_ = 0;
+  if (leaf_ == nullptr || index_ >= leaf_->GetSize()) {
+    return;
+  }
+  ValueType value = leaf_->GetItem(index_).second;
+  if (BPlusTreePostingPage::IsReference(value)) {
+    ReadPostings(value, bufferPoolManager_, postings_);
+  }
+}
+
+/*
+ * Append all values referred to by value, in order. The caller holds a latch
+ * on the leaf page that owns the posting list.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::ReadPostings(const ValueType &value,
+                                      BufferPoolManager *bufferPoolManager,
+                                      std::vector<ValueType> &result) {
+  if (!BPlusTreePostingPage::IsReference(value)) {
+    result.push_back(value);
+    return;
+  }
+  for (page_id_t pid = value.GetPageId(); pid != INVALID_PAGE_ID;) {
+    Page *page = bufferPoolManager->FetchPage(pid);
+    BPlusTreePostingPage *posting =
+        reinterpret_cast<BPlusTreePostingPage *>(page->GetData());
+    for (int i = 0; i < posting->GetSize(); i++) {
+      result.push_back(posting->RIDAt(i));
+    }
+    page_id_t next = posting->GetNextPageId();
+    bufferPoolManager->UnpinPage(pid, false);
+    pid = next;
+  }
+}
+
+/*****************************************************************************
+ * REVERSE ITERATOR
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+REVERSE_INDEXITERATOR_TYPE::ReverseIndexIterator(
+    BPlusTree<KeyType, ValueType, KeyComparator> *tree,
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf, int index,
+    BufferPoolManager *bufferPoolManager, const KeyType *bound)
+    : tree_(tree), index_(index), leaf_(leaf),
+      bufferPoolManager_(bufferPoolManager), bounded_(bound != nullptr) {
+  if (bounded_) {
+    bound_ = *bound;
+  }
+  if (leaf_ != nullptr && index_ < 0) {
+    MoveToPrevLeaf();
+  }
+  LoadPostings();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+REVERSE_INDEXITERATOR_TYPE::~ReverseIndexIterator() {
+  if (leaf_ != nullptr) {
+    UnlockAndUnPin();
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+REVERSE_INDEXITERATOR_TYPE &REVERSE_INDEXITERATOR_TYPE::operator++() {
+  if (!postings_.empty() && posting_ > 0) {
+    posting_--;
+    return *this;
+  }
+  postings_.clear();
+  bound_ = leaf_->KeyAt(index_);
+  bounded_ = true;
+  index_--;
+  if (index_ < 0) {
+    MoveToPrevLeaf();
+  }
+  LoadPostings();
+  return *this;
+}
+
+/*
+ * Release the current leaf and latch the leaf holding the greatest key below
+ * bound_, ending the scan at the leftmost leaf; throws if the left sibling
+ * can not be fetched. The left sibling is pinned before the current leaf is
+ * released (its prev page id is kept up to date under the latch of this
+ * leaf), so its frame stays valid while it is checked. A coalesce may still unlink it in between: the buffer pool then
+ * refuses to delete the pinned page, the tree keeps it for a retry, and
+ * ReleasePage deletes it once the iterator unpins it.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void REVERSE_INDEXITERATOR_TYPE::MoveToPrevLeaf() {
+  while (index_ < 0) {
+    page_id_t cur = leaf_->GetPageId();
+    page_id_t prev = leaf_->GetPrevPageId();
+    Page *page = nullptr;
+    if (prev != INVALID_PAGE_ID) {
+      page = bufferPoolManager_->FetchPage(prev);
+      if (page == nullptr) {
+        // not the end of the scan, the pool is exhausted
+        UnlockAndUnPin();
+        leaf_ = nullptr;
+        throw Exception(EXCEPTION_TYPE_INDEX, "all page are pinned");
+      }
+    }
+    UnlockAndUnPin();
+    leaf_ = nullptr;
+    if (page == nullptr) {
+      return;
+    }
+    page->RLatch();
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf =
+        reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+    if (!leaf->IsLeafPage() || leaf->GetNextPageId() != cur) {
+      page->RUnlatch();
+      tree_->ReleasePage(prev, false);
+      page = tree_->FindPrevLeafPage(bound_, !bounded_);
+      if (page == nullptr) {
+        return;
+      }
+      leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+    }
+    leaf_ = leaf;
+    index_ = bounded_ ? leaf_->KeyIndex(bound_, tree_->comparator_) - 1
+                      : leaf_->GetSize() - 1;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void REVERSE_INDEXITERATOR_TYPE::LoadPostings() {
+  postings_.clear();
+  posting_ = 0;
+  if (leaf_ == nullptr) {
+    return;
+  }
+  ValueType value = leaf_->GetItem(index_).second;
+  if (BPlusTreePostingPage::IsReference(value)) {
+    INDEXITERATOR_TYPE::ReadPostings(value, bufferPoolManager_, postings_);
+    posting_ = postings_.size() - 1;
+  }
+}
 
 template class IndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
 template class IndexIterator<GenericKey<8>, RID, GenericComparator<8>>;
 template class IndexIterator<GenericKey<16>, RID, GenericComparator<16>>;
 template class IndexIterator<GenericKey<32>, RID, GenericComparator<32>>;
 template class IndexIterator<GenericKey<64>, RID, GenericComparator<64>>;
+template class IndexIterator<IntegerKey<int32_t>, RID, IntegerComparator<int32_t>>;
+template class IndexIterator<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>>;
+
+template class ReverseIndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
+template class ReverseIndexIterator<GenericKey<8>, RID, GenericComparator<8>>;
+template class ReverseIndexIterator<GenericKey<16>, RID, GenericComparator<16>>;
+template class ReverseIndexIterator<GenericKey<32>, RID, GenericComparator<32>>;
+template class ReverseIndexIterator<GenericKey<64>, RID, GenericComparator<64>>;
+template class ReverseIndexIterator<IntegerKey<int32_t>, RID, IntegerComparator<int32_t>>;
+template class ReverseIndexIterator<IntegerKey<int64_t>, RID, IntegerComparator<int64_t>>;
 
 } // namespace scudb
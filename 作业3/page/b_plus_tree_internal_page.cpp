@@ -1,6 +1,7 @@
 /**
  * b_plus_tree_internal_page.cpp
  */
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
@@ -14,17 +15,27 @@ namespace scudb {
  *****************************************************************************/
 /*
  * Init method after creating a new internal page
- * Including set page type, set current size, set page id, set parent id and set
- * max page size
+ * Including set page type, set current size, set page id and set max page size.
+ * A new page is not the root, caller marks it. The entry layout is fixed here,
+ * see BPlusTreeLeafPage::Init. A counted page gives up entries for the counts.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id,
-                                          page_id_t parent_id) {
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id, bool columnar,
+                                          bool prefix, bool counted,
+                                          KeySearch search) {
   SetPageType(IndexPageType::INTERNAL_PAGE);
+  SetCounted(counted);
+  SetKeySearch(search);
+  SetColumnarLayout(columnar);
+  if (prefix && IsMemcmpOrdered<KeyType>::value) {
+    SetPrefixLayout(true);
+    *reinterpret_cast<uint16_t *>(array) = 0;
+  }
   SetSize(0);
   SetPageId(page_id);
-  SetParentPageId(parent_id);
-  SetMaxSize((PAGE_SIZE- sizeof(BPlusTreeInternalPage))/sizeof(MappingType) - 1); //minus 1 for first invalid key
+  SetRootPage(false);
+  SetMaxSize(Capacity() - 1); //minus 1 for first invalid key
+  SetMinSize(GetMaxSize() / 2);
 }
 /*
  * Helper method to get/set the key associated with input "index"(a.k.a
@@ -32,13 +43,13 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id,
  */
 INDEX_TEMPLATE_ARGUMENTS
 KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const {
-  KeyType k=array[index].first;
+  KeyType k=LoadKey(index);
   return k;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyAt(int index, const KeyType &key) {
-  array[index].first = key;
+  StoreKey(index, key);
 }
 
 /*
@@ -61,10 +72,74 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(const ValueType &value) const {
  */
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const {
-  ValueType v=array[index].second;
+  ValueType v=LoadValue(index);
   return v;
 }
 
+/*
+ * Helper methods to get/set the subtree count of the child at index, caller
+ * keeps counts up to date (see BPlusTree::SubtreeCount)
+ */
+INDEX_TEMPLATE_ARGUMENTS
+uint32_t B_PLUS_TREE_INTERNAL_PAGE_TYPE::CountAt(int index) const {
+  assert(IsCounted() && index >= 0 && index < Capacity());
+  return *CountSlot(index);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetCountAt(int index, uint32_t count) {
+  assert(IsCounted() && index >= 0 && index < Capacity());
+  *CountSlot(index) = count;
+}
+
+/*
+ * Helper methods to copy a key or value in or out of the entry at index, see
+ * BPlusTreeLeafPage::LoadKey. Only the part of the unused first key after
+ * the page prefix is kept.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::LoadKey(int index) const {
+  if (!IsPrefixLayout())
+    return KeySlot(index);
+  KeyType key;
+  char *bytes = reinterpret_cast<char *>(&key);
+  memcpy(bytes, Prefix(), PrefixSize());
+  memcpy(bytes + PrefixSize(), Entry(index), sizeof(KeyType) - PrefixSize());
+  return key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::StoreKey(int index, const KeyType &key) {
+  if (!IsPrefixLayout()) {
+    KeySlot(index) = key;
+    return;
+  }
+  const char *bytes = reinterpret_cast<const char *>(&key);
+  assert(index == 0 || memcmp(bytes, Prefix(), PrefixSize()) == 0);
+  memcpy(Entry(index), bytes + PrefixSize(), sizeof(KeyType) - PrefixSize());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::LoadValue(int index) const {
+  if (!IsPrefixLayout())
+    return ValueSlot(index);
+  ValueType value;
+  memcpy(static_cast<void *>(&value),
+         Entry(index) + sizeof(KeyType) - PrefixSize(), sizeof(ValueType));
+  return value;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::StoreValue(int index,
+                                                const ValueType &value) {
+  if (!IsPrefixLayout()) {
+    ValueSlot(index) = value;
+    return;
+  }
+  memcpy(Entry(index) + sizeof(KeyType) - PrefixSize(),
+         static_cast<const void *>(&value), sizeof(ValueType));
+}
+
 /*****************************************************************************
  * LOOKUP
  *****************************************************************************/
@@ -78,6 +153,16 @@ ValueType
 B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key,
                                        const KeyComparator &comparator) const {
   assert(GetSize() > 1);
+  if (IsInterpolated())
+    return ValueSlot(InterpolationKeyBound(
+        GetSize() - 1, key,
+        [this](int i) -> const KeyType & { return KeySlot(i + 1); },
+        comparator, true));
+  if (IsColumnarLayout())
+    return ValueSlot(KeyUpperBound(Keys() + 1, GetSize() - 1, key, comparator));
+  if (IsPrefixLayout())
+    return LoadValue(PrefixKeyBound(Prefix(), PrefixSize(), Entry(1),
+                                    EntrySize(), GetSize() - 1, key, true));
   int l =1, r = GetSize() - 1;
   while (l<=r) { 
     int mid = (r+l)/2;
@@ -89,6 +174,18 @@ B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key,
   return array[l-1].second;
 }
 
+/*
+ * The first key is invalid, the sample is taken from the others
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SampleKeySearch() {
+  if (GetKeySearch() != KeySearch::ADAPTIVE || IsPrefixLayout())
+    return;
+  SetInterpolated(IsEvenlySpread<KeyType>(
+      GetSize() - 1,
+      [this](int i) -> const KeyType & { return KeySlot(i + 1); }));
+}
+
 /*****************************************************************************
  * INSERTION
  *****************************************************************************/
@@ -102,9 +199,9 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::PopulateNewRoot(
     const ValueType &old_value, const KeyType &new_key,
     const ValueType &new_value) {
-  array[1].first = new_key;
-  array[1].second = new_value;
-  array[0].second = old_value;
+  StoreKey(1, new_key);
+  StoreValue(1, new_value);
+  StoreValue(0, old_value);
   IncreaseSize(2);
 }
 /*
@@ -117,11 +214,9 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(
     const ValueType &old_value, const KeyType &new_key,
     const ValueType &new_value) {
   int index = ValueIndex(old_value) + 1;
-  for (int i = GetSize(); i > index; i--) {
-    array[i]= array[i - 1];
-  }
-  array[index].first = new_key;
-  array[index].second = new_value;
+  MoveSlots(this, index + 1, index, GetSize() - index);
+  StoreKey(index, new_key);
+  StoreValue(index, new_value);
   IncreaseSize(1);
   return GetSize();
 }
@@ -130,30 +225,69 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(
  * SPLIT
  *****************************************************************************/
 /*
- * Remove half of key & value pairs from this page to "recipient" page
+ * Remove half of key & value pairs from this page to "recipient" page, or all
+ * but the first keep of them
+ * Children do not store their parent, so moved children are not touched
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(
     BPlusTreeInternalPage *recipient,
-    BufferPoolManager *buffer_pool_manager) {
+    __attribute__((unused)) BufferPoolManager *buffer_pool_manager,
+    int keep) {
   int total = GetMaxSize() + 1;
-  page_id_t newId = recipient->GetPageId();
-  for (int i = total/2; i < total; i++) {
-    recipient->array[i - total/2] = array[i];
-    Page* crp = buffer_pool_manager->FetchPage(array[i].second);
-    BPlusTreePage *cp = reinterpret_cast<BPlusTreePage *>(crp->GetData());
-    cp->SetParentPageId(newId);
-    buffer_pool_manager->UnpinPage(array[i].second,true);
-  }
-  recipient->SetSize(total - total/2);
-  SetSize(total/2);
-  
+  if (keep < 0)
+    keep = total/2;
+  assert(keep > 0 && keep < total);
+  if (IsPrefixLayout())
+    recipient->SetPrefix(Prefix(), PrefixSize());
+  MoveSlots(recipient, 0, keep, total - keep);
+  recipient->SetSize(total - keep);
+  SetSize(keep);
+  SampleKeySearch();
+  recipient->SampleKeySearch();
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyHalfFrom(
     MappingType *items, int size, BufferPoolManager *buffer_pool_manager) {}
 
+/*
+ * Copy n entries starting at "from" of this page to "to" of recipient page,
+ * recipient may be this page and the two ranges may overlap. Counts go along
+ * when both pages are counted.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveSlots(
+    BPlusTreeInternalPage *recipient, int to, int from, int n) {
+  if (n <= 0)
+    return;
+  if (IsCounted() && recipient->IsCounted()) {
+    // counts run backwards, the last slot of a range has the lowest address
+    memmove(recipient->CountSlot(to + n - 1), CountSlot(from + n - 1),
+            n * sizeof(uint32_t));
+  }
+  if (IsPrefixLayout() && recipient->IsPrefixLayout() &&
+      PrefixSize() == recipient->PrefixSize() &&
+      memcmp(Prefix(), recipient->Prefix(), PrefixSize()) == 0) {
+    memmove(recipient->Entry(to), Entry(from), n * EntrySize());
+  } else if (IsColumnarLayout() != recipient->IsColumnarLayout() ||
+             IsPrefixLayout() || recipient->IsPrefixLayout()) {
+    // never the same page
+    for (int i = 0; i < n; i++) {
+      recipient->StoreKey(to + i, LoadKey(from + i));
+      recipient->StoreValue(to + i, LoadValue(from + i));
+    }
+  } else if (IsColumnarLayout()) {
+    memmove(static_cast<void *>(recipient->Keys() + to), Keys() + from,
+            n * sizeof(KeyType));
+    memmove(static_cast<void *>(recipient->Values() + to), Values() + from,
+            n * sizeof(ValueType));
+  } else {
+    memmove(static_cast<void *>(recipient->array + to), array + from,
+            n * sizeof(MappingType));
+  }
+}
+
 /*****************************************************************************
  * REMOVE
  *****************************************************************************/
@@ -164,12 +298,20 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyHalfFrom(
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) {
-  for (int i = index + 1; i < GetSize(); i++) {
-    array[i - 1] = array[i];
-  }
+  MoveSlots(this, index, index + 1, GetSize() - index - 1);
   IncreaseSize(-1);
 }
 
+/*
+ * Remove the key & value pairs at index [from, to) with a single shift
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveRange(int from, int to) {
+  assert(0 <= from && from <= to && to <= GetSize());
+  MoveSlots(this, from, to, GetSize() - to);
+  IncreaseSize(from - to);
+}
+
 /*
  * Remove the only key & value pair in internal page and return the value
  * NOTE: only call this method within AdjustRoot()(in b_plus_tree.cpp)
@@ -180,31 +322,96 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveAndReturnOnlyChild() {
   SetSize(0);
   return r;
 }
+
+/*****************************************************************************
+ * KEY PREFIX
+ *****************************************************************************/
+/*
+ * Same as BPlusTreeLeafPage, the unused first key may lose bytes it does not
+ * share with the new prefix
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetPrefixSize() const {
+  return IsPrefixLayout() ? PrefixSize() : 0;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetPrefix(const char *prefix,
+                                               int prefix_size) {
+  if (prefix_size == PrefixSize() &&
+      memcmp(prefix, Prefix(), prefix_size) == 0)
+    return;
+  alignas(BPlusTreeInternalPage) char old[PAGE_SIZE];
+  memcpy(old, this, PAGE_SIZE);
+  const BPlusTreeInternalPage *src =
+      reinterpret_cast<BPlusTreeInternalPage *>(old);
+  char bytes[sizeof(KeyType)];
+  memcpy(bytes, prefix, prefix_size);
+  *reinterpret_cast<uint16_t *>(array) = prefix_size;
+  memcpy(Prefix(), bytes, prefix_size);
+  assert(GetSize() < Capacity());
+  for (int i = 0; i < GetSize(); i++) {
+    StoreKey(i, src->LoadKey(i));
+    StoreValue(i, src->LoadValue(i));
+  }
+  SetMaxSize(Capacity() - 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyRange(const KeyType *low,
+                                                 const KeyType *high) {
+  if (!IsPrefixLayout())
+    return;
+  KeyType first;
+  int n = KeyRangePrefixSize(Prefix(), PrefixSize(), low, high, first);
+  SetPrefix(reinterpret_cast<const char *>(&first), n);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::SharedPrefixSize(
+    const BPlusTreeInternalPage *other) const {
+  if (!IsPrefixLayout() || !other->IsPrefixLayout())
+    return 0;
+  int n = 0;
+  while (n < PrefixSize() && n < other->PrefixSize() &&
+         Prefix()[n] == other->Prefix()[n])
+    n++;
+  return n;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SharePrefixWith(
+    const BPlusTreeInternalPage *other) {
+  if (!IsPrefixLayout())
+    return;
+  SetPrefix(Prefix(), SharedPrefixSize(other));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::MaxSizeWith(
+    const BPlusTreeInternalPage *sibling) const {
+  if (!IsPrefixLayout())
+    return GetMaxSize();
+  return PrefixCapacity(SharedPrefixSize(sibling)) - 1;
+}
 /*****************************************************************************
  * MERGE
  *****************************************************************************/
 /*
- * Remove all of key & value pairs from this page to "recipient" page, then
- * update relavent key & value pair in its parent page.
+ * Remove all of key & value pairs from this page to "recipient" page. The
+ * separator from parent page (middle_key) becomes the key of the first moved
+ * child; caller removes this page from parent page.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(
-    BPlusTreeInternalPage *recipient, int index_in_parent,
-    BufferPoolManager *buffer_pool_manager) {
-  Page *newp = buffer_pool_manager->FetchPage(GetParentPageId());
-  B_PLUS_TREE_INTERNAL_PAGE_TYPE *pp = reinterpret_cast<BPlusTreeInternalPage *>(newp->GetData());
-  SetKeyAt(0, pp->KeyAt(index_in_parent));
-  buffer_pool_manager->UnpinPage(pp->GetPageId(), false);
-  
+    BPlusTreeInternalPage *recipient, const KeyType &middle_key,
+    __attribute__((unused)) BufferPoolManager *buffer_pool_manager) {
+  recipient->SharePrefixWith(this);
+  SetKeyAt(0, middle_key);
   int a = recipient->GetSize();
-  for (int i = 0; i < GetSize(); ++i) {
-    recipient->array[a + i] = array[i];
-    Page* crp = buffer_pool_manager->FetchPage(array[i].second);
-    BPlusTreePage *cp = reinterpret_cast<BPlusTreePage *>(crp->GetData());
-    cp->SetParentPageId(recipient->GetPageId());
-    buffer_pool_manager->UnpinPage(array[i].second,true);
-  }
+  MoveSlots(recipient, a, 0, GetSize());
   recipient->SetSize(a + GetSize());
+  recipient->SampleKeySearch();
   SetSize(0);
 }
 
@@ -218,67 +425,94 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyAllFrom(
  *****************************************************************************/
 /*
  * Remove the first key & value pair from this page to tail of "recipient"
- * page, then update relavent key & value pair in its parent page.
+ * page, the moved child goes under middle_key (separator of recipient and this
+ * page in parent page). Caller updates the separator to KeyAt(0) of this page.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(
-    BPlusTreeInternalPage *recipient,
+    BPlusTreeInternalPage *recipient, const KeyType &middle_key,
     BufferPoolManager *buffer_pool_manager) {
-  recipient->CopyLastFrom(array[0], buffer_pool_manager);
-  Page *p = buffer_pool_manager->FetchPage(array[0].second);
-  BPlusTreePage *cp = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  cp->SetParentPageId(recipient->GetPageId());
-  buffer_pool_manager->UnpinPage(cp->GetPageId(), true);
-  
+  recipient->SharePrefixWith(this);
+  recipient->CopyLastFrom(MappingType(middle_key, LoadValue(0)),
+                          buffer_pool_manager);
+  if (IsCounted() && recipient->IsCounted())
+    recipient->SetCountAt(recipient->GetSize() - 1, CountAt(0));
   IncreaseSize(-1);
-  for(int i=0;i<GetSize();i++){
-    array[i]=array[i+1];
-  }
-  
-  Page *p2 = buffer_pool_manager->FetchPage(GetParentPageId());
-  B_PLUS_TREE_INTERNAL_PAGE_TYPE *pp = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE_TYPE *>(p2->GetData());
-  pp->SetKeyAt(pp->ValueIndex(GetPageId()), array[0].first);
-  buffer_pool_manager->UnpinPage(GetParentPageId(), true);
+  MoveSlots(this, 0, 1, GetSize());
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(
     const MappingType &pair, BufferPoolManager *buffer_pool_manager) {
-  array[GetSize()] = pair;
+  StoreKey(GetSize(), pair.first);
+  StoreValue(GetSize(), pair.second);
   IncreaseSize(1);
 }
 
 /*
  * Remove the last key & value pair from this page to head of "recipient"
- * page, then update relavent key & value pair in its parent page.
+ * page, the old first child of recipient goes under middle_key (separator of
+ * this page and recipient in parent page). Caller updates the separator to
+ * KeyAt(0) of recipient.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(
-    BPlusTreeInternalPage *recipient, int parent_index,
+    BPlusTreeInternalPage *recipient, const KeyType &middle_key,
     BufferPoolManager *buffer_pool_manager) {
-  recipient->CopyFirstFrom(array[GetSize()-1], parent_index, buffer_pool_manager);
+  recipient->SharePrefixWith(this);
+  recipient->SetKeyAt(0, middle_key);
+  recipient->CopyFirstFrom(MappingType(LoadKey(GetSize()-1),
+                                      LoadValue(GetSize()-1)),
+                          buffer_pool_manager);
+  if (IsCounted() && recipient->IsCounted())
+    recipient->SetCountAt(0, CountAt(GetSize() - 1));
   IncreaseSize(-1);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyFirstFrom(
-    const MappingType &pair, int parent_index,
-    BufferPoolManager *buffer_pool_manager) {
-  for(int i=GetSize();i>0;i--){
-    array[i]=array[i-1];
-  }  
+    const MappingType &pair,
+    __attribute__((unused)) BufferPoolManager *buffer_pool_manager) {
+  MoveSlots(this, 1, 0, GetSize());
   IncreaseSize(1);
-  array[0] = pair;
+  StoreKey(0, pair.first);
+  StoreValue(0, pair.second);
+}
 
-  Page *p = buffer_pool_manager->FetchPage(pair.second);
-  BPlusTreePage *cp = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  cp->SetParentPageId(GetPageId());
-  buffer_pool_manager->UnpinPage(cp->GetPageId(), true);
-  
-  Page *p2 = buffer_pool_manager->FetchPage(GetParentPageId());
-  B_PLUS_TREE_INTERNAL_PAGE_TYPE *pp = reinterpret_cast<B_PLUS_TREE_INTERNAL_PAGE_TYPE *>(p2->GetData());
-  pp->SetKeyAt(parent_index, array[0].first);
-  buffer_pool_manager->UnpinPage(GetParentPageId(), true);
+/*****************************************************************************
+ * B-LINK
+ *****************************************************************************/
+/*
+ * Give up one entry of capacity so that the slot right after the overflow
+ * slot can hold high key + right sibling page id: keys >= high key belong to
+ * the right sibling. The high key is meaningless while right page id is
+ * invalid.
+ * NOTE: only call this right after Init()
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::ReserveHighKey() {
+  SetMaxSize(GetMaxSize() - 1);
+  SetRightPageId(INVALID_PAGE_ID);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetHighKey() const {
+  return KeySlot(GetMaxSize() + 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetHighKey(const KeyType &key) {
+  KeySlot(GetMaxSize() + 1) = key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetRightPageId() const {
+  return ValueSlot(GetMaxSize() + 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetRightPageId(page_id_t right_page_id) {
+  ValueSlot(GetMaxSize() + 1) = right_page_id;
 }
 
 /*****************************************************************************
@@ -289,7 +523,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::QueueUpChildren(
     std::queue<BPlusTreePage *> *queue,
     BufferPoolManager *buffer_pool_manager) {
   for (int i = 0; i < GetSize(); i++) {
-    auto *page = buffer_pool_manager->FetchPage(array[i].second);
+    auto *page = buffer_pool_manager->FetchPage(LoadValue(i));
     if (page == nullptr)
       throw Exception(EXCEPTION_TYPE_INDEX,
                       "all page are pinned while printing");
@@ -306,7 +540,7 @@ std::string B_PLUS_TREE_INTERNAL_PAGE_TYPE::ToString(bool verbose) const {
   }
   std::ostringstream os;
   if (verbose) {
-    os << "[pageId: " << GetPageId() << " parentId: " << GetParentPageId()
+    os << "[pageId: " << GetPageId() << " root: " << IsRootPage()
        << "]<" << GetSize() << "> ";
   }
 
@@ -319,9 +553,9 @@ std::string B_PLUS_TREE_INTERNAL_PAGE_TYPE::ToString(bool verbose) const {
     } else {
       os << " ";
     }
-    os << std::dec << array[entry].first.ToString();
+    os << std::dec << LoadKey(entry).ToString();
     if (verbose) {
-      os << "(" << array[entry].second << ")";
+      os << "(" << LoadValue(entry) << ")";
     }
     ++entry;
   }
@@ -339,4 +573,8 @@ template class BPlusTreeInternalPage<GenericKey<32>, page_id_t,
                                            GenericComparator<32>>;
 template class BPlusTreeInternalPage<GenericKey<64>, page_id_t,
                                            GenericComparator<64>>;
+template class BPlusTreeInternalPage<IntegerKey<int32_t>, page_id_t,
+                                           IntegerComparator<int32_t>>;
+template class BPlusTreeInternalPage<IntegerKey<int64_t>, page_id_t,
+                                           IntegerComparator<int64_t>>;
 } // namespace scudb
@@ -2,6 +2,8 @@
  * b_plus_tree_leaf_page.cpp
  */
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 #include "common/exception.h"
@@ -16,18 +18,37 @@ namespace scudb {
 
 /**
  * Init method after creating a new leaf page
- * Including set page type, set current size to zero, set page id/parent id, set
- * next page id and set max size
+ * Including set page type, set current size to zero, set page id, set next
+ * and prev page id and set max size. A new page is not the root, caller marks it
+ * The entry layout is fixed here: row (key & value pairs), columnar (keys
+ * and values in separate arrays), prefix (row layout with a shared key
+ * prefix, empty at first) or slotted (prefix layout with variable length
+ * entries). Min size is half of the max size without prefix. So is the key
+ * search, an adaptive page starts out with binary search.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id) {
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, bool columnar,
+                                      bool prefix, bool slotted,
+                                      KeySearch search) {
   SetPageId(page_id);
-  SetParentPageId(parent_id);
+  SetRootPage(false);
   SetPageType(IndexPageType::LEAF_PAGE);
+  SetCounted(false);
+  SetKeySearch(search);
+  SetColumnarLayout(columnar);
+  if (slotted && IsMemcmpOrdered<KeyType>::value) {
+    SetSlottedLayout(true);
+    *reinterpret_cast<uint16_t *>(array) = 0;
+    FreeSpacePointer() = PAGE_SIZE;
+  } else if (prefix && IsMemcmpOrdered<KeyType>::value) {
+    SetPrefixLayout(true);
+    *reinterpret_cast<uint16_t *>(array) = 0;
+  }
   SetSize(0);
-  SetMaxSize((PAGE_SIZE- sizeof(BPlusTreeLeafPage))/sizeof(MappingType) - 1);
-  assert(sizeof(BPlusTreeLeafPage) == 28);
+  SetMaxSize(Capacity() - 1);
+  SetMinSize(GetMaxSize() / 2);
   SetNextPageId(INVALID_PAGE_ID);
+  SetPrevPageId(INVALID_PAGE_ID);
 }
 
 /**
@@ -43,6 +64,19 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) {
   next_page_id_=next_page_id;
 }
 
+/**
+ * Helper methods to set/get prev page id
+ */
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrevPageId() const {
+  return prev_page_id_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetPrevPageId(page_id_t prev_page_id) {
+  prev_page_id_=prev_page_id;
+}
+
 /**
  * Helper method to find the first index i so that array[i].first >= key
  * NOTE: This method is only used when generating index iterator
@@ -51,6 +85,19 @@ INDEX_TEMPLATE_ARGUMENTS
 int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(
     const KeyType &key, const KeyComparator &comparator) const {
   assert(GetSize()>=0);
+  if (IsInterpolated())
+    return InterpolationKeyBound(
+        GetSize(), key, [this](int i) -> const KeyType & { return KeySlot(i); },
+        comparator, false);
+  if (IsColumnarLayout())
+    return KeyLowerBound(Keys(), GetSize(), key, comparator);
+  if (IsSlottedLayout())
+    return SlottedKeyBound(Prefix(), PrefixSize(),
+                           reinterpret_cast<const char *>(this), Slots(),
+                           GetSize(), key, false);
+  if (IsPrefixLayout())
+    return PrefixKeyBound(Prefix(), PrefixSize(), Entry(0), EntrySize(),
+                          GetSize(), key, false);
   int l=0;
   int r=GetSize()-1;
   while(l<=r){
@@ -61,6 +108,14 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(
   return r+1; 
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SampleKeySearch() {
+  if (GetKeySearch() != KeySearch::ADAPTIVE || IsPrefixLayout())
+    return;
+  SetInterpolated(IsEvenlySpread<KeyType>(
+      GetSize(), [this](int i) -> const KeyType & { return KeySlot(i); }));
+}
+
 /*
  * Helper method to find and return the key associated with input "index"(a.k.a
  * array offset)
@@ -70,7 +125,7 @@ KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const {
   // replace with your own code
   KeyType key;
   assert(index>=0&&index<GetSize());
-  key=array[index].first;
+  key=LoadKey(index);
   return key;
 }
 
@@ -79,10 +134,230 @@ KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const {
  * "index"(a.k.a array offset)
  */
 INDEX_TEMPLATE_ARGUMENTS
-const MappingType &B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) {
+MappingType B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) {
   // replace with your own code
   assert(index>=0&&index<GetSize());
-  return array[index];
+  return MappingType(LoadKey(index), LoadValue(index));
+}
+
+/*
+ * Helper methods to copy a key or value in or out of the entry at index,
+ * for every layout. A key stored in a prefix layout page must start with
+ * the page prefix. Storing the key of a slotted page entry puts a new entry
+ * into the heap, the value is stored after it; the old entry stays until
+ * Reclaim.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::LoadKey(int index) const {
+  if (!IsPrefixLayout())
+    return KeySlot(index);
+  KeyType key;
+  char *bytes = reinterpret_cast<char *>(&key);
+  memcpy(bytes, Prefix(), PrefixSize());
+  if (IsSlottedLayout()) {
+    int size = Slots()[2 * index + 1];
+    memcpy(bytes + PrefixSize(), Record(index), size);
+    memset(bytes + PrefixSize() + size, 0,
+           sizeof(KeyType) - PrefixSize() - size);
+    return key;
+  }
+  memcpy(bytes + PrefixSize(), Entry(index), sizeof(KeyType) - PrefixSize());
+  return key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::StoreKey(int index, const KeyType &key) {
+  if (!IsPrefixLayout()) {
+    KeySlot(index) = key;
+    return;
+  }
+  const char *bytes = reinterpret_cast<const char *>(&key);
+  assert(memcmp(bytes, Prefix(), PrefixSize()) == 0);
+  if (IsSlottedLayout()) {
+    int size = std::max(KeyBytesSize(key) - PrefixSize(), 0);
+    int offset = FreeSpacePointer() - size - sizeof(ValueType);
+    assert(offset >= SlotsOffset(PrefixSize()) +
+                         std::max(index + 1, GetSize()) * SlotSize());
+    memcpy(reinterpret_cast<char *>(this) + offset, bytes + PrefixSize(), size);
+    FreeSpacePointer() = offset;
+    Slots()[2 * index] = offset;
+    Slots()[2 * index + 1] = size;
+    return;
+  }
+  memcpy(Entry(index), bytes + PrefixSize(), sizeof(KeyType) - PrefixSize());
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+ValueType B_PLUS_TREE_LEAF_PAGE_TYPE::LoadValue(int index) const {
+  if (!IsPrefixLayout())
+    return ValueSlot(index);
+  ValueType value;
+  const char *src = IsSlottedLayout()
+                        ? Record(index) + Slots()[2 * index + 1]
+                        : Entry(index) + sizeof(KeyType) - PrefixSize();
+  memcpy(static_cast<void *>(&value), src, sizeof(ValueType));
+  return value;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::StoreValue(int index,
+                                            const ValueType &value) {
+  if (!IsPrefixLayout()) {
+    ValueSlot(index) = value;
+    return;
+  }
+  char *dst = IsSlottedLayout()
+                  ? Record(index) + Slots()[2 * index + 1]
+                  : Entry(index) + sizeof(KeyType) - PrefixSize();
+  memcpy(dst, static_cast<const void *>(&value), sizeof(ValueType));
+}
+
+/*
+ * Slotted layout: drop the heap entries no slot points at any more, then set
+ * max size from the free space. Called at the end of every change.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Reclaim() {
+  if (!IsSlottedLayout())
+    return;
+  int used = 0;
+  for (int i = 0; i < GetSize(); i++)
+    used += Slots()[2 * i + 1] + sizeof(ValueType);
+  if (FreeSpacePointer() + used < PAGE_SIZE) {
+    alignas(BPlusTreeLeafPage) char old[PAGE_SIZE];
+    memcpy(old, this, PAGE_SIZE);
+    int offset = PAGE_SIZE;
+    for (int i = 0; i < GetSize(); i++) {
+      int size = Slots()[2 * i + 1] + sizeof(ValueType);
+      offset -= size;
+      memcpy(reinterpret_cast<char *>(this) + offset, old + Slots()[2 * i],
+             size);
+      Slots()[2 * i] = offset;
+    }
+    FreeSpacePointer() = offset;
+  }
+  SetMaxSize(Capacity() - 1);
+}
+
+/*****************************************************************************
+ * KEY PREFIX
+ *****************************************************************************/
+/*
+ * Bytes of the key prefix stored once for the whole page, 0 unless prefix
+ * layout
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrefixSize() const {
+  return IsPrefixLayout() ? PrefixSize() : 0;
+}
+
+/*
+ * Re-encode all entries with the first prefix_size bytes of prefix as page
+ * prefix (prefix may point into this page), which every key must start with.
+ * Max size follows the new capacity. A slotted page is rebuilt from scratch.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetPrefix(const char *prefix,
+                                           int prefix_size) {
+  if (prefix_size == PrefixSize() &&
+      memcmp(prefix, Prefix(), prefix_size) == 0)
+    return;
+  alignas(BPlusTreeLeafPage) char old[PAGE_SIZE];
+  memcpy(old, this, PAGE_SIZE);
+  const BPlusTreeLeafPage *src = reinterpret_cast<BPlusTreeLeafPage *>(old);
+  char bytes[sizeof(KeyType)];
+  memcpy(bytes, prefix, prefix_size);
+  *reinterpret_cast<uint16_t *>(array) = prefix_size;
+  memcpy(Prefix(), bytes, prefix_size);
+  if (IsSlottedLayout())
+    FreeSpacePointer() = PAGE_SIZE;
+  else
+    assert(GetSize() < Capacity());
+  for (int i = 0; i < GetSize(); i++) {
+    StoreKey(i, src->LoadKey(i));
+    StoreValue(i, src->LoadValue(i));
+  }
+  SetMaxSize(Capacity() - 1);
+}
+
+/*
+ * Set the prefix to the bytes shared by all keys of [low, high), the new key
+ * range of this page. A null bound keeps that end of the range: the lowest
+ * (highest) key with the current prefix is taken instead.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetKeyRange(const KeyType *low,
+                                             const KeyType *high) {
+  if (!IsPrefixLayout())
+    return;
+  KeyType first;
+  int n = KeyRangePrefixSize(Prefix(), PrefixSize(), low, high, first);
+  SetPrefix(reinterpret_cast<const char *>(&first), n);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::SharedPrefixSize(
+    const BPlusTreeLeafPage *other) const {
+  if (!IsPrefixLayout() || !other->IsPrefixLayout())
+    return 0;
+  int n = 0;
+  while (n < PrefixSize() && n < other->PrefixSize() &&
+         Prefix()[n] == other->Prefix()[n])
+    n++;
+  return n;
+}
+
+/*
+ * Cut the prefix down to the part shared with other, before taking over
+ * entries of other
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SharePrefixWith(
+    const BPlusTreeLeafPage *other) {
+  if (!IsPrefixLayout())
+    return;
+  SetPrefix(Prefix(), SharedPrefixSize(other));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::MaxSizeWith(
+    const BPlusTreeLeafPage *sibling) const {
+  if (!IsPrefixLayout())
+    return GetMaxSize();
+  int prefix_size = SharedPrefixSize(sibling);
+  if (!IsSlottedLayout())
+    return PrefixCapacity(prefix_size) - 1;
+  int size = GetSize() + sibling->GetSize();
+  int free = PAGE_SIZE - SlotsOffset(prefix_size) -
+             SlottedBytes(prefix_size) - sibling->SlottedBytes(prefix_size);
+  return free < 0 ? size - 1 : size + free / SlottedEntrySize(prefix_size) - 1;
+}
+
+/*
+ * An entry of a prefix page that gives up part of its prefix grows by at
+ * most that part, an entry of another layout counts as the longest key
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::SlottedBytes(int prefix_size) const {
+  if (!IsSlottedLayout())
+    return GetSize() * SlottedEntrySize(prefix_size);
+  int bytes = 0;
+  for (int i = 0; i < GetSize(); i++)
+    bytes += SlotSize() + Slots()[2 * i + 1] + PrefixSize() - prefix_size +
+             sizeof(ValueType);
+  return bytes;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::IsFilled(double fill_factor) const {
+  if (GetSize() >= GetMaxSize())
+    return true;
+  if (!IsSlottedLayout())
+    return GetSize() >=
+           std::max(GetMinSize(), static_cast<int>(GetMaxSize() * fill_factor));
+  int space = PAGE_SIZE - SlotsOffset(PrefixSize());
+  return GetSize() >= GetMinSize() &&
+         SlottedBytes(PrefixSize()) >= space * fill_factor;
 }
 
 /*****************************************************************************
@@ -97,37 +372,88 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &key,
                                        const ValueType &value,
                                        const KeyComparator &comparator) {
   int idx=KeyIndex(key,comparator);
+  MoveSlots(this, idx + 1, idx, GetSize() - idx);
   IncreaseSize(1);
-  for(int i=GetSize()-1;i>idx;i--){
-    array[i].first=array[i-1].first;
-    array[i].second=array[i-1].second;
-  }
-  array[idx].first=key;
-  array[idx].second=value;
+  StoreKey(idx,key);
+  StoreValue(idx,value);
+  Reclaim();
   return GetSize();
 }
 
+/*
+ * Copy n entries starting at "from" of this page to "to" of recipient page,
+ * recipient may be this page and the two ranges may overlap. Within a slotted
+ * page only the slots move.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveSlots(BPlusTreeLeafPage *recipient,
+                                           int to, int from, int n) {
+  if (n <= 0)
+    return;
+  if (IsSlottedLayout() && recipient == this) {
+    assert(SlotsOffset(PrefixSize()) + (to + n) * SlotSize() <=
+           FreeSpacePointer());
+    memmove(Slots() + 2 * to, Slots() + 2 * from, n * SlotSize());
+  } else if (IsPrefixLayout() && recipient->IsPrefixLayout() &&
+             !IsSlottedLayout() && !recipient->IsSlottedLayout() &&
+             PrefixSize() == recipient->PrefixSize() &&
+      memcmp(Prefix(), recipient->Prefix(), PrefixSize()) == 0) {
+    memmove(recipient->Entry(to), Entry(from), n * EntrySize());
+  } else if (IsColumnarLayout() != recipient->IsColumnarLayout() ||
+             IsPrefixLayout() || recipient->IsPrefixLayout()) {
+    // never the same page
+    for (int i = 0; i < n; i++) {
+      recipient->StoreKey(to + i, LoadKey(from + i));
+      recipient->StoreValue(to + i, LoadValue(from + i));
+    }
+  } else if (IsColumnarLayout()) {
+    memmove(static_cast<void *>(recipient->Keys() + to), Keys() + from,
+            n * sizeof(KeyType));
+    memmove(static_cast<void *>(recipient->Values() + to), Values() + from,
+            n * sizeof(ValueType));
+  } else {
+    memmove(static_cast<void *>(recipient->array + to), array + from,
+            n * sizeof(MappingType));
+  }
+}
+
 /*****************************************************************************
  * SPLIT
  *****************************************************************************/
 /*
- * Remove half of key & value pairs from this page to "recipient" page
+ * Remove half of key & value pairs from this page to "recipient" page (or all
+ * but the first keep of them), which is linked in right after this page.
+ * Caller points the prev page id of the old next page at recipient.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveHalfTo(
     BPlusTreeLeafPage *recipient,
-    __attribute__((unused)) BufferPoolManager *buffer_pool_manager) {
+    __attribute__((unused)) BufferPoolManager *buffer_pool_manager,
+    int keep) {
   assert(recipient!=nullptr);
   int max=GetMaxSize()+1;
   assert(GetSize()>=max);
-  for(int i=max/2, j=0;i<max;i++,j++){
-    recipient->array[j].first=array[i].first;
-    recipient->array[j].second=array[i].second;
+  if (keep < 0 && IsSlottedLayout()) {
+    // entries differ in size, split the bytes in half
+    int half = SlottedBytes(PrefixSize()) / 2;
+    for (keep = 0; keep < max - 1 && half > 0; keep++)
+      half -= SlotSize() + Slots()[2 * keep + 1] + sizeof(ValueType);
+    keep = std::max(keep, 1);
   }
-  recipient->SetSize(max/2);
-  SetSize(max-max/2);
+  if(keep<0) keep=max/2;
+  assert(keep>0&&keep<max);
+  if (IsPrefixLayout())
+    recipient->SetPrefix(Prefix(), PrefixSize());
+  MoveSlots(recipient, 0, keep, max-keep);
+  recipient->SetSize(max-keep);
+  SetSize(keep);
+  Reclaim();
+  recipient->Reclaim();
+  SampleKeySearch();
+  recipient->SampleKeySearch();
   
   recipient->SetNextPageId(GetNextPageId());
+  recipient->SetPrevPageId(GetPageId());
   SetNextPageId(recipient->GetPageId());
 
 }
@@ -147,14 +473,30 @@ INDEX_TEMPLATE_ARGUMENTS
 bool B_PLUS_TREE_LEAF_PAGE_TYPE::Lookup(const KeyType &key, ValueType &value,
                                         const KeyComparator &comparator) const {
   int idx=KeyIndex(key,comparator);
-  if(comparator(array[idx].first, key) == 0){
-    value=array[idx].second;
+  if(idx<GetSize() && comparator(LoadKey(idx), key) == 0){
+    value=LoadValue(idx);
     return true;
   }
   else
     return false;
 }
 
+/*
+ * Replace the value of an existing key
+ * @return  false if the key does not exist
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::SetValue(const KeyType &key,
+                                          const ValueType &value,
+                                          const KeyComparator &comparator) {
+  int idx=KeyIndex(key,comparator);
+  if(idx<GetSize() && comparator(LoadKey(idx), key) == 0){
+    StoreValue(idx,value);
+    return true;
+  }
+  return false;
+}
+
 /*****************************************************************************
  * REMOVE
  *****************************************************************************/
@@ -168,37 +510,51 @@ INDEX_TEMPLATE_ARGUMENTS
 int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAndDeleteRecord(
     const KeyType &key, const KeyComparator &comparator) {
   int idx=KeyIndex(key,comparator);
-  if(comparator(array[idx].first, key) == 0){
-    for(int i=idx;i<GetSize()-1;i++){
-      array[i].first=array[i+1].first;
-      array[i].second=array[i+1].second;
-    }
+  if(idx<GetSize() && comparator(LoadKey(idx), key) == 0){
+    MoveSlots(this, idx, idx + 1, GetSize() - idx - 1);
     SetSize(GetSize()-1);
+    Reclaim();
     return GetSize();
   }
   else
     return GetSize();
 }
 
+/*
+ * Remove key & value pairs at index [from, to) with a single shift
+ * @return   page size after deletion
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveRange(int from, int to) {
+  assert(0 <= from && from <= to && to <= GetSize());
+  MoveSlots(this, from, to, GetSize() - to);
+  IncreaseSize(from - to);
+  Reclaim();
+  return GetSize();
+}
+
 /*****************************************************************************
  * MERGE
  *****************************************************************************/
 /*
  * Remove all of key & value pairs from this page to "recipient" page, then
- * update next page id
+ * update next page id. Recipient is the left sibling, caller points the prev
+ * page id of the next page at recipient. A prefix layout recipient keeps
+ * only the prefix part it shares with this page.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient,
-                                           int, BufferPoolManager *) {
+                                           const KeyType &,
+                                           BufferPoolManager *) {
   assert(recipient!=nullptr);
-  int a=recipient->GetSize();
-  for(int i=0;i<GetSize();i++){
-    recipient->array[a+i].first=array[i].first;
-    recipient->array[a+i].second=array[i].second;
-  }
+  recipient->SharePrefixWith(this);
+  MoveSlots(recipient, recipient->GetSize(), 0, GetSize());
   recipient->SetNextPageId(GetNextPageId());
   recipient->IncreaseSize(GetSize());
+  recipient->Reclaim();
+  recipient->SampleKeySearch();
   SetSize(0);
+  Reclaim();
 }
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyAllFrom(MappingType *items, int size) {}
@@ -207,51 +563,73 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyAllFrom(MappingType *items, int size) {}
  * REDISTRIBUTE
  *****************************************************************************/
 /*
- * Remove the first key & value pair from this page to "recipient" page, then
- * update relavent key & value pair in its parent page.
+ * Remove the first key & value pair from this page to "recipient" page. Caller
+ * updates the separator in parent page (to KeyAt(0) of this page).
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(
-    BPlusTreeLeafPage *recipient,
-    BufferPoolManager *buffer_pool_manager) {
+    BPlusTreeLeafPage *recipient, const KeyType &, BufferPoolManager *) {
   MappingType aa=GetItem(0);
   IncreaseSize(-1);
+  recipient->SharePrefixWith(this);
   recipient->CopyLastFrom(aa);
-  for(int i=0;i<GetSize();i++){
-    array[i].first=array[i+1].first;
-    array[i].second=array[i+1].second;
-  }
+  MoveSlots(this, 0, 1, GetSize());
+  Reclaim();
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyLastFrom(const MappingType &item) {
   assert(GetSize()+1<=GetMaxSize());
-  array[GetSize()]=item;
+  StoreKey(GetSize(),item.first);
+  StoreValue(GetSize(),item.second);
   IncreaseSize(1);
+  Reclaim();
 }
 /*
- * Remove the last key & value pair from this page to "recipient" page, then
- * update relavent key & value pair in its parent page.
+ * Remove the last key & value pair from this page to "recipient" page. Caller
+ * updates the separator in parent page (to KeyAt(0) of recipient).
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(
-    BPlusTreeLeafPage *recipient, int parentIndex,
-    BufferPoolManager *buffer_pool_manager) {
+    BPlusTreeLeafPage *recipient, const KeyType &, BufferPoolManager *) {
   MappingType aa=GetItem(GetSize()-1);
-  recipient->CopyFirstFrom(aa,parentIndex,buffer_pool_manager);
+  recipient->SharePrefixWith(this);
+  recipient->CopyFirstFrom(aa);
   IncreaseSize(-1);    
+  Reclaim();
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyFirstFrom(
-    const MappingType &item, int parentIndex,
-    BufferPoolManager *buffer_pool_manager) {
-  for(int i=GetSize()+1;i>0;i--){
-    array[i].first=array[i-1].first;
-    array[i].second=array[i-1].second;
-  }
-  array[0]=item;
+void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyFirstFrom(const MappingType &item) {
+  MoveSlots(this, 1, 0, GetSize());
+  StoreKey(0,item.first);
+  StoreValue(0,item.second);
   IncreaseSize(1);    
+  Reclaim();
+}
+
+/*****************************************************************************
+ * B-LINK
+ *****************************************************************************/
+/*
+ * Give up one entry of capacity so that the slot right after the overflow
+ * slot can hold the high key: keys >= high key belong to the next page.
+ * The high key is meaningless while next page id is invalid.
+ * NOTE: only call this right after Init()
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::ReserveHighKey() {
+  SetMaxSize(GetMaxSize() - 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::GetHighKey() const {
+  return KeySlot(GetMaxSize() + 1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetHighKey(const KeyType &key) {
+  KeySlot(GetMaxSize() + 1) = key;
 }
 
 /*****************************************************************************
@@ -264,7 +642,7 @@ std::string B_PLUS_TREE_LEAF_PAGE_TYPE::ToString(bool verbose) const {
   }
   std::ostringstream stream;
   if (verbose) {
-    stream << "[pageId: " << GetPageId() << " parentId: " << GetParentPageId()
+    stream << "[pageId: " << GetPageId() << " root: " << IsRootPage()
            << "]<" << GetSize() << "> ";
   }
   int entry = 0;
@@ -277,9 +655,9 @@ std::string B_PLUS_TREE_LEAF_PAGE_TYPE::ToString(bool verbose) const {
     } else {
       stream << " ";
     }
-    stream << std::dec << array[entry].first;
+    stream << std::dec << LoadKey(entry);
     if (verbose) {
-      stream << "(" << array[entry].second << ")";
+      stream << "(" << LoadValue(entry) << ")";
     }
     ++entry;
   }
@@ -296,4 +674,8 @@ template class BPlusTreeLeafPage<GenericKey<32>, RID,
                                        GenericComparator<32>>;
 template class BPlusTreeLeafPage<GenericKey<64>, RID,
                                        GenericComparator<64>>;
+template class BPlusTreeLeafPage<IntegerKey<int32_t>, RID,
+                                       IntegerComparator<int32_t>>;
+template class BPlusTreeLeafPage<IntegerKey<int64_t>, RID,
+                                       IntegerComparator<int64_t>>;
 } // namespace scudb
@@ -15,21 +15,66 @@ bool BPlusTreePage::IsLeafPage() const {
   else
     return false; 
   }
-bool BPlusTreePage::IsRootPage() const { 
-  if(parent_page_id_==INVALID_PAGE_ID)
-    return true;
-  else
-    return false; 
-  }
+bool BPlusTreePage::IsRootPage() const { return is_root_; }
+void BPlusTreePage::SetRootPage(bool is_root) {is_root_=is_root;}
 void BPlusTreePage::SetPageType(IndexPageType page_type) {page_type_=page_type;}
 
+/*
+ * Helper methods to get/set entry array layout, fixed at page Init
+ */
+bool BPlusTreePage::IsColumnarLayout() const {
+  return layout_ == PageLayout::COLUMNAR;
+}
+void BPlusTreePage::SetColumnarLayout(bool columnar) {
+  layout_ = columnar ? PageLayout::COLUMNAR : PageLayout::ROW;
+}
+// a slotted page is a prefix layout page too
+bool BPlusTreePage::IsPrefixLayout() const {
+  return layout_ == PageLayout::PREFIX || layout_ == PageLayout::SLOTTED;
+}
+void BPlusTreePage::SetPrefixLayout(bool prefix) {
+  layout_ = prefix ? PageLayout::PREFIX : PageLayout::ROW;
+}
+bool BPlusTreePage::IsSlottedLayout() const {
+  return layout_ == PageLayout::SLOTTED;
+}
+void BPlusTreePage::SetSlottedLayout(bool slotted) {
+  layout_ = slotted ? PageLayout::SLOTTED : PageLayout::ROW;
+}
+
+/*
+ * Helper methods to get/set whether an internal page keeps subtree counts,
+ * fixed at page Init
+ */
+bool BPlusTreePage::IsCounted() const { return counted_; }
+void BPlusTreePage::SetCounted(bool counted) { counted_ = counted; }
+
+/*
+ * Helper methods to get/set the key search of the page, fixed at page Init.
+ * An adaptive page interpolates once a sample of its keys turned out evenly
+ * spread, until the next sample.
+ */
+KeySearch BPlusTreePage::GetKeySearch() const { return key_search_; }
+void BPlusTreePage::SetKeySearch(KeySearch search) {
+  key_search_ = search;
+  interpolate_ = search == KeySearch::INTERPOLATION;
+}
+bool BPlusTreePage::IsInterpolated() const {
+  return interpolate_ && !IsPrefixLayout();
+}
+void BPlusTreePage::SetInterpolated(bool interpolate) {
+  if (key_search_ == KeySearch::ADAPTIVE)
+    interpolate_ = interpolate;
+}
+
 /*
  * Helper methods to get/set size (number of key/value pairs stored in that
- * page)
+ * page), a new size also moves the page on to a new version
  */
 int BPlusTreePage::GetSize() const { return size_; }
-void BPlusTreePage::SetSize(int size) {size_=size;}
-void BPlusTreePage::IncreaseSize(int amount) {size_=size_+amount;}
+void BPlusTreePage::SetSize(int size) {size_=size;version_++;}
+void BPlusTreePage::IncreaseSize(int amount) {size_=size_+amount;version_++;}
+uint16_t BPlusTreePage::GetVersion() const { return version_; }
 
 /*
  * Helper methods to get/set max size (capacity) of the page
@@ -39,21 +84,18 @@ void BPlusTreePage::SetMaxSize(int size) {max_size_=size;}
 
 /*
  * Helper method to get min page size
- * Generally, min page size == max page size / 2
+ * Generally, min page size == max page size / 2. The max size of a prefix
+ * layout page changes with its prefix, its min size is set at Init instead.
  */
 int BPlusTreePage::GetMinSize() const { 
   if(IsRootPage()){
     if(IsLeafPage()) return 1;
     else return 2;
     }
+  else if(IsPrefixLayout()) return min_size_;
   else return GetMaxSize()/2;
   }
-
-/*
- * Helper methods to get/set parent page id
- */
-page_id_t BPlusTreePage::GetParentPageId() const { return parent_page_id_; }
-void BPlusTreePage::SetParentPageId(page_id_t parent_page_id) {parent_page_id_=parent_page_id;}
+void BPlusTreePage::SetMinSize(int min_size) { min_size_ = min_size; }
 
 /*
  * Helper methods to get/set self page id
@@ -66,11 +108,12 @@ void BPlusTreePage::SetPageId(page_id_t page_id) {page_id_=page_id;}
  */
 void BPlusTreePage::SetLSN(lsn_t lsn) { lsn_ = lsn; }
 
-bool BPlusTreePage::IsSafe(OpType op){
+bool BPlusTreePage::IsSafe(OpType op, int min_size){
   if(op==OpType::INSERT){
     return GetSize()<GetMaxSize();
   }
-  int min=GetMinSize()+1;
+  if(min_size<0||IsRootPage()) min_size=GetMinSize();
+  int min=min_size+1;
   if(op==OpType::DELETE){
     if(IsLeafPage()) return GetSize()>=min;
     else return GetSize()>min;
@@ -0,0 +1,114 @@
+/**
+ * b_plus_tree_posting_page.cpp
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include "page/b_plus_tree_posting_page.h"
+
+namespace scudb {
+
+/*****************************************************************************
+ * HELPER METHODS AND UTILITIES
+ *****************************************************************************/
+/**
+ * Init method after creating a new posting page
+ * Including set page id, set current size to zero and set next page id
+ */
+void BPlusTreePostingPage::Init(page_id_t page_id) {
+  page_id_ = page_id;
+  lsn_ = INVALID_LSN;
+  size_ = 0;
+  next_page_id_ = INVALID_PAGE_ID;
+}
+
+page_id_t BPlusTreePostingPage::GetPageId() const { return page_id_; }
+
+void BPlusTreePostingPage::SetLSN(lsn_t lsn) { lsn_ = lsn; }
+
+int BPlusTreePostingPage::GetSize() const { return size_; }
+
+int BPlusTreePostingPage::GetMaxSize() const {
+  return (PAGE_SIZE - sizeof(BPlusTreePostingPage)) / sizeof(RID);
+}
+
+page_id_t BPlusTreePostingPage::GetNextPageId() const { return next_page_id_; }
+
+void BPlusTreePostingPage::SetNextPageId(page_id_t next_page_id) {
+  next_page_id_ = next_page_id;
+}
+
+RID BPlusTreePostingPage::RIDAt(int index) const {
+  assert(index >= 0 && index < size_);
+  return array[index];
+}
+
+/*
+ * Helper method to find the first index i so that array[i] >= rid
+ */
+int BPlusTreePostingPage::RIDIndex(const RID &rid) const {
+  int l = 0, r = size_;
+  while (l < r) {
+    int mid = (l + r) / 2;
+    if (array[mid].Get() < rid.Get())
+      l = mid + 1;
+    else
+      r = mid;
+  }
+  return l;
+}
+
+/*****************************************************************************
+ * INSERTION AND REMOVE
+ *****************************************************************************/
+bool BPlusTreePostingPage::Contains(const RID &rid) const {
+  int idx = RIDIndex(rid);
+  return idx < size_ && array[idx] == rid;
+}
+
+/*
+ * Insert rid in order, caller splits a full page first
+ * @return  false if rid already exists
+ */
+bool BPlusTreePostingPage::Insert(const RID &rid) {
+  int idx = RIDIndex(rid);
+  if (idx < size_ && array[idx] == rid) {
+    return false;
+  }
+  assert(size_ < GetMaxSize());
+  memmove(static_cast<void *>(array + idx + 1), array + idx,
+          (size_ - idx) * sizeof(RID));
+  array[idx] = rid;
+  size_++;
+  return true;
+}
+
+/*
+ * @return  false if rid does not exist
+ */
+bool BPlusTreePostingPage::Remove(const RID &rid) {
+  int idx = RIDIndex(rid);
+  if (idx == size_ || !(array[idx] == rid)) {
+    return false;
+  }
+  memmove(static_cast<void *>(array + idx), array + idx + 1,
+          (size_ - idx - 1) * sizeof(RID));
+  size_--;
+  return true;
+}
+
+/*
+ * Move the upper half of rids to recipient and link it in after this page
+ */
+void BPlusTreePostingPage::MoveHalfTo(BPlusTreePostingPage *recipient) {
+  int half = size_ / 2;
+  memcpy(static_cast<void *>(recipient->array), array + half,
+         (size_ - half) * sizeof(RID));
+  recipient->size_ = size_ - half;
+  size_ = half;
+  recipient->next_page_id_ = next_page_id_;
+  next_page_id_ = recipient->page_id_;
+}
+
+} // namespace scudb
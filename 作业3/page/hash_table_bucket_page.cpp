@@ -0,0 +1,127 @@
+/**
+ * hash_table_bucket_page.cpp
+ */
+
+#include "common/rid.h"
+#include "page/hash_table_bucket_page.h"
+
+namespace scudb {
+
+/*****************************************************************************
+ * HELPER METHODS AND UTILITIES
+ *****************************************************************************/
+/**
+ * Init method after creating a new bucket page
+ * Including set page id, set current size to zero and set max size
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void HASH_TABLE_BUCKET_PAGE_TYPE::Init(page_id_t page_id) {
+  page_id_ = page_id;
+  lsn_ = INVALID_LSN;
+  size_ = 0;
+  max_size_ = (PAGE_SIZE - sizeof(HashTableBucketPage)) / sizeof(MappingType);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t HASH_TABLE_BUCKET_PAGE_TYPE::GetPageId() const { return page_id_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void HASH_TABLE_BUCKET_PAGE_TYPE::SetLSN(lsn_t lsn) { lsn_ = lsn; }
+
+INDEX_TEMPLATE_ARGUMENTS
+int HASH_TABLE_BUCKET_PAGE_TYPE::GetSize() const { return size_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+int HASH_TABLE_BUCKET_PAGE_TYPE::GetMaxSize() const { return max_size_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+bool HASH_TABLE_BUCKET_PAGE_TYPE::IsFull() const { return size_ >= max_size_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType HASH_TABLE_BUCKET_PAGE_TYPE::KeyAt(int index) const {
+  assert(index >= 0 && index < size_);
+  return array[index].first;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+ValueType HASH_TABLE_BUCKET_PAGE_TYPE::ValueAt(int index) const {
+  assert(index >= 0 && index < size_);
+  return array[index].second;
+}
+
+/*
+ * Entries are unsorted, so find the key by linear scan
+ * @return  index of the key, -1 if it does not exist
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int HASH_TABLE_BUCKET_PAGE_TYPE::KeyIndex(
+    const KeyType &key, const KeyComparator &comparator) const {
+  for (int i = 0; i < size_; i++) {
+    if (comparator(array[i].first, key) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*****************************************************************************
+ * INSERTION
+ *****************************************************************************/
+/*
+ * Append key & value pair to the end of bucket
+ * @return  false if key already exists or bucket is full
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool HASH_TABLE_BUCKET_PAGE_TYPE::Insert(const KeyType &key,
+                                         const ValueType &value,
+                                         const KeyComparator &comparator) {
+  if (IsFull() || KeyIndex(key, comparator) != -1) {
+    return false;
+  }
+  array[size_].first = key;
+  array[size_].second = value;
+  size_++;
+  return true;
+}
+
+/*****************************************************************************
+ * LOOKUP
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+bool HASH_TABLE_BUCKET_PAGE_TYPE::Lookup(const KeyType &key, ValueType &value,
+                                         const KeyComparator &comparator) const {
+  int idx = KeyIndex(key, comparator);
+  if (idx == -1) {
+    return false;
+  }
+  value = array[idx].second;
+  return true;
+}
+
+/*****************************************************************************
+ * REMOVE
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+bool HASH_TABLE_BUCKET_PAGE_TYPE::Remove(const KeyType &key,
+                                         const KeyComparator &comparator) {
+  int idx = KeyIndex(key, comparator);
+  if (idx == -1) {
+    return false;
+  }
+  RemoveAt(idx);
+  return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void HASH_TABLE_BUCKET_PAGE_TYPE::RemoveAt(int index) {
+  assert(index >= 0 && index < size_);
+  array[index] = array[size_ - 1];
+  size_--;
+}
+
+template class HashTableBucketPage<GenericKey<4>, RID, GenericComparator<4>>;
+template class HashTableBucketPage<GenericKey<8>, RID, GenericComparator<8>>;
+template class HashTableBucketPage<GenericKey<16>, RID, GenericComparator<16>>;
+template class HashTableBucketPage<GenericKey<32>, RID, GenericComparator<32>>;
+template class HashTableBucketPage<GenericKey<64>, RID, GenericComparator<64>>;
+} // namespace scudb
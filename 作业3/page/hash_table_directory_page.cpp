@@ -0,0 +1,94 @@
+/**
+ * hash_table_directory_page.cpp
+ */
+#include <cassert>
+#include <cstring>
+
+#include "page/hash_table_directory_page.h"
+
+namespace scudb {
+
+/*
+ * Init method after creating a new directory page
+ * A fresh directory has global depth 0 and a single slot
+ */
+void HashTableDirectoryPage::Init(page_id_t page_id) {
+  page_id_ = page_id;
+  lsn_ = INVALID_LSN;
+  global_depth_ = 0;
+  memset(local_depths_, 0, sizeof(local_depths_));
+  for (size_t i = 0; i < DIRECTORY_ARRAY_SIZE; i++) {
+    bucket_page_ids_[i] = INVALID_PAGE_ID;
+  }
+}
+
+page_id_t HashTableDirectoryPage::GetPageId() const { return page_id_; }
+
+void HashTableDirectoryPage::SetLSN(lsn_t lsn) { lsn_ = lsn; }
+
+/*
+ * Helper methods for global depth
+ */
+int HashTableDirectoryPage::GetGlobalDepth() const { return global_depth_; }
+
+uint32_t HashTableDirectoryPage::GetGlobalDepthMask() const {
+  return (1U << global_depth_) - 1;
+}
+
+/*
+ * The directory lives in a single page, so it can hold at most the largest
+ * power of two slots that fits in DIRECTORY_ARRAY_SIZE
+ */
+int HashTableDirectoryPage::GetMaxDepth() const {
+  int depth = 0;
+  while ((2U << depth) <= DIRECTORY_ARRAY_SIZE) {
+    depth++;
+  }
+  return depth;
+}
+
+bool HashTableDirectoryPage::CanGrow() const {
+  return global_depth_ < GetMaxDepth();
+}
+
+/*
+ * Double the directory, the new upper half points to the same buckets as the
+ * lower half (same as ExtendibleHash::Insert)
+ */
+void HashTableDirectoryPage::IncrGlobalDepth() {
+  assert(CanGrow());
+  int length = Size();
+  for (int i = 0; i < length; i++) {
+    bucket_page_ids_[i + length] = bucket_page_ids_[i];
+    local_depths_[i + length] = local_depths_[i];
+  }
+  global_depth_++;
+}
+
+int HashTableDirectoryPage::Size() const { return 1 << global_depth_; }
+
+/*
+ * Helper methods to get/set bucket page id and local depth of a slot
+ */
+page_id_t HashTableDirectoryPage::GetBucketPageId(int index) const {
+  assert(index >= 0 && index < Size());
+  return bucket_page_ids_[index];
+}
+
+void HashTableDirectoryPage::SetBucketPageId(int index,
+                                             page_id_t bucket_page_id) {
+  assert(index >= 0 && index < Size());
+  bucket_page_ids_[index] = bucket_page_id;
+}
+
+int HashTableDirectoryPage::GetLocalDepth(int index) const {
+  assert(index >= 0 && index < Size());
+  return local_depths_[index];
+}
+
+void HashTableDirectoryPage::SetLocalDepth(int index, int local_depth) {
+  assert(index >= 0 && index < Size());
+  local_depths_[index] = local_depth;
+}
+
+} // namespace scudb